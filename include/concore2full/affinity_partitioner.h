@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace concore2full {
+
+/**
+ * @brief Remembers which workers executed the parts of a bulk spawn, so that a later bulk spawn
+ * over the same indices executes the same parts on the same workers.
+ *
+ * Pass the same partitioner object to repeated bulk spawns over the same data. A bulk spawn
+ * divides the indices into one range per task; the partitioner records the worker of the thread
+ * pool that executed each task. On the next bulk spawn with the partitioner, each task is enqueued
+ * on the work line owned by the recorded worker, and that worker is woken up first, so that the
+ * worker that touched a range of the data (and may still have it in its caches) is the first to
+ * get the same range again. Work stealing is still allowed, so the load stays balanced.
+ *
+ * A partitioner must not be used by two bulk spawns at the same time.
+ */
+class affinity_partitioner {
+public:
+  affinity_partitioner() = default;
+
+  //! Returns the workers recorded for the tasks of a bulk spawn with `task_count` tasks; a
+  //! negative value means that there is no recorded worker for the task. Used by the
+  //! implementation of bulk spawns.
+  int32_t* worker_lines(uint32_t task_count) {
+    if (lines_.size() != task_count)
+      lines_.assign(task_count, -1);
+    return lines_.data();
+  }
+
+private:
+  //! The worker that executed each task of the last bulk spawn.
+  std::vector<int32_t> lines_;
+};
+
+} // namespace concore2full
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "concore2full/detail/bulk_context_frame.h"
+#include "concore2full/detail/raw_delete.h"
+#include "concore2full/future.h"
+
+#include <cassert>
+#include <cstdint>
+#include <utility>
+
+namespace concore2full {
+
+class thread_pool;
+
+/**
+ * @brief Context for repeatedly bulk spawning work, without allocating memory for each spawn.
+ *
+ * A `bulk_spawn` call allocates a frame, initializes it, and frees it after the await. Algorithms
+ * that bulk spawn work many times in a loop (e.g., iterative solvers) can use a `bulk_context`
+ * instead: the context allocates a frame once, large enough for any number of indices, and
+ * re-arms it for each bulk spawn. Re-arming doesn't allocate memory; it just resets the state of
+ * the frame, in time proportional to the number of workers of the thread pool.
+ *
+ * At most one bulk spawn made through a context can be in progress at a time: the future returned
+ * by a bulk spawn needs to be awaited before starting the next one. The context needs to outlive
+ * the returned futures.
+ *
+ * Example:
+ * @code
+ * concore2full::bulk_context ctx;
+ * for (int iter = 0; iter < 1000; iter++)
+ *   ctx.bulk_spawn(n, [&](int64_t i) { relax(i); }).await();
+ * @endcode
+ */
+class bulk_context {
+public:
+  //! Creates a context for spawning work on the current thread pool.
+  bulk_context();
+  //! Creates a context for spawning work on `pool`; `pool` needs to outlive this object.
+  explicit bulk_context(thread_pool& pool);
+
+  bulk_context(const bulk_context&) = delete;
+  bulk_context& operator=(const bulk_context&) = delete;
+
+  //! Same as `concore2full::bulk_spawn(count, f)`, but using the frame of this context.
+  template <typename Fn> auto bulk_spawn(int64_t count, Fn&& f) {
+    assert(count > 0);
+    using frame_holder_t = detail::bulk_context_holder<Fn, false>;
+    return future<frame_holder_t>{detail::start_spawn_t{}, *frame_, count,
+                                  detail::bulk_spawn_frame_base::per_index_grain,
+                                  std::forward<Fn>(f)};
+  }
+
+  //! Same as `concore2full::bulk_spawn_chunked(count, grain, f)`, but using the frame of this
+  //! context.
+  template <typename Fn> auto bulk_spawn_chunked(int64_t count, int64_t grain, Fn&& f) {
+    assert(count > 0);
+    assert(grain >= 0);
+    using frame_holder_t = detail::bulk_context_holder<Fn, true>;
+    return future<frame_holder_t>{detail::start_spawn_t{}, *frame_, count, grain,
+                                  std::forward<Fn>(f)};
+  }
+
+private:
+  //! The frame reused by all the bulk spawns.
+  detail::raw_unique_ptr<detail::bulk_context_frame> frame_;
+};
+
+} // namespace concore2full
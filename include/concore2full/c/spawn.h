@@ -10,7 +10,7 @@ extern "C" {
 //! Data needed to perform a `spawn` operation.
 //! Must be at least the size that the implementation expects.
 struct concore2full_spawn_frame {
-  void* data[10];
+  void* data[12];
 };
 
 //! Data needed to perform a `bulk_spawn` operation.
@@ -32,11 +32,12 @@ void concore2full_spawn(struct concore2full_spawn_frame* frame, concore2full_spa
 void concore2full_await(struct concore2full_spawn_frame* frame);
 
 //! Returns the full size of the `concore2full_bulk_spawn_frame` structure, given the number of work
-//! items.
-uint64_t concore2full_frame_size(int32_t count);
+//! items. The size is an upper bound that doesn't depend on the thread pool; the frame can be
+//! spawned from any thread.
+uint64_t concore2full_frame_size(int64_t count);
 
 //! Asynchronously executes `f`, using the given `frame` to hold the state.
-void concore2full_bulk_spawn(struct concore2full_bulk_spawn_frame* frame, int32_t count,
+void concore2full_bulk_spawn(struct concore2full_bulk_spawn_frame* frame, int64_t count,
                              concore2full_bulk_spawn_function_t f);
 
 //! Await the async computations represented by `frame` to be finished.
@@ -45,7 +46,7 @@ void concore2full_bulk_await(struct concore2full_bulk_spawn_frame* frame);
 // TEMPORARY WORKAROUND
 
 void concore2full_spawn2(struct concore2full_spawn_frame* frame, concore2full_spawn_function_t* f);
-void concore2full_bulk_spawn2(struct concore2full_bulk_spawn_frame* frame, int32_t* count,
+void concore2full_bulk_spawn2(struct concore2full_bulk_spawn_frame* frame, int64_t* count,
                               concore2full_bulk_spawn_function_t* f);
 
 #ifdef __cplusplus
@@ -7,7 +7,9 @@ extern "C" {
 
 struct concore2full_task;
 
-//! Type of a function that can be executed as a task.
+//! Type of a function that can be executed as a task. `worker_index` is the index of the worker
+//! thread of the thread pool that executes the task; negative if the task is executed by a thread
+//! that is helping the thread pool.
 typedef void (*concore2full_task_function_t)(struct concore2full_task* task, int worker_index);
 
 //! A task that can be executed.
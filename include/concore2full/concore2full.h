@@ -1,3 +1,4 @@
 #pragma once
 
 #include "spawn.h"
+#include "when_all.h"
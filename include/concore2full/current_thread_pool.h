@@ -0,0 +1,60 @@
+#pragma once
+
+namespace concore2full {
+
+class thread_pool;
+
+//! Returns the thread pool used by the current control flow to spawn new work.
+//!
+//! This is the pool set by the innermost `scoped_thread_pool` object, or the pool executing the
+//! current task, or the global thread pool.
+thread_pool& current_thread_pool() noexcept;
+
+/**
+ * @brief Sets the thread pool used by the current control flow to spawn new work, for the duration
+ * of a scope.
+ *
+ * The current thread pool follows the control flow, not the OS thread: if the control flow
+ * continues on a different OS thread (e.g., after an `await()`), the current thread pool stays
+ * the same.
+ */
+class scoped_thread_pool {
+public:
+  //! Makes `pool` the current thread pool, until the end of the scope.
+  explicit scoped_thread_pool(thread_pool& pool) noexcept;
+  //! Restores the previous current thread pool.
+  ~scoped_thread_pool();
+
+  scoped_thread_pool(const scoped_thread_pool&) = delete;
+  scoped_thread_pool& operator=(const scoped_thread_pool&) = delete;
+
+private:
+  //! The pool that was current before this object was created; null for the default.
+  thread_pool* previous_;
+};
+
+namespace detail {
+
+//! Returns the thread pool explicitly set for the current control flow; null for the default.
+thread_pool* current_thread_pool_override() noexcept;
+
+//! Sets the thread pool for the current control flow; null means the global thread pool.
+void set_current_thread_pool_override(thread_pool* pool) noexcept;
+
+//! Preserves the current thread pool of the control flow across operations that may move the
+//! control flow to a different OS thread.
+struct preserve_current_thread_pool {
+  preserve_current_thread_pool() noexcept : saved_(current_thread_pool_override()) {}
+  ~preserve_current_thread_pool() { set_current_thread_pool_override(saved_); }
+
+  preserve_current_thread_pool(const preserve_current_thread_pool&) = delete;
+  preserve_current_thread_pool& operator=(const preserve_current_thread_pool&) = delete;
+
+private:
+  //! The pool to be restored.
+  thread_pool* saved_;
+};
+
+} // namespace detail
+
+} // namespace concore2full
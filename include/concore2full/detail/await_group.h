@@ -0,0 +1,49 @@
+#pragma once
+
+#include "concore2full/suspend.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace concore2full::detail {
+
+/**
+ * @brief Shared completion state for a group of spawned computations that are awaited together.
+ *
+ * Each member of the group calls `arrive()` when its computation completes. Depending on the mode,
+ * the group is considered done when all the members arrived, or when the first member arrived.
+ *
+ * The thread awaiting the group suspends at most once, regardless of the number of members.
+ */
+struct await_group {
+  //! Value of `first_arrived()` if no member arrived yet.
+  static constexpr uint32_t no_index = uint32_t(-1);
+
+  //! Creates a group with `count` members; if `wait_for_all` is false, the group is done once the
+  //! first member arrives.
+  await_group(uint32_t count, bool wait_for_all);
+
+  //! Called when the member with the given index completes.
+  void arrive(uint32_t index) noexcept;
+
+  //! Returns `true` if the group is done.
+  bool is_done() const noexcept;
+
+  //! Suspends the current execution until the group is done.
+  void wait();
+
+  //! Returns the index of the first member that arrived.
+  uint32_t first_arrived() const noexcept { return first_arrived_.load(std::memory_order_acquire); }
+
+private:
+  //! The number of members that didn't arrive yet.
+  std::atomic<uint32_t> pending_;
+  //! The index of the first member to arrive.
+  std::atomic<uint32_t> first_arrived_{no_index};
+  //! Whether we wait for all the members, or just for the first one.
+  bool wait_for_all_;
+  //! Token used to wake up the thread waiting on the group.
+  suspend_token suspend_token_;
+};
+
+} // namespace concore2full::detail
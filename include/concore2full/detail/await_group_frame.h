@@ -0,0 +1,136 @@
+#pragma once
+
+#include "concore2full/detail/await_group.h"
+#include "concore2full/detail/completion_link.h"
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace concore2full::detail {
+
+//! The result of awaiting a `when_any` group without members.
+constexpr std::size_t empty_group_index = std::numeric_limits<std::size_t>::max();
+
+//! Calls `f(base_frame, index)` for each future in `members`.
+template <typename... Futures, typename F>
+inline void for_each_member(std::tuple<Futures&...>& members, F&& f) {
+  [&]<std::size_t... Is>(std::index_sequence<Is...>) {
+    (f(std::get<Is>(members).frame_holder().base_frame(), uint32_t(Is)), ...);
+  }(std::index_sequence_for<Futures...>{});
+}
+//! Calls `f(base_frame, index)` for each future in `members`.
+template <typename Future, typename F>
+inline void for_each_member(std::span<Future>& members, F&& f) {
+  for (uint32_t i = 0; i < members.size(); i++)
+    f(members[i].frame_holder().base_frame(), i);
+}
+
+//! Returns the number of futures in `members`.
+template <typename... Futures> constexpr uint32_t member_count(std::tuple<Futures&...>&) {
+  return uint32_t(sizeof...(Futures));
+}
+//! Returns the number of futures in `members`.
+template <typename Future> inline uint32_t member_count(std::span<Future>& members) {
+  return uint32_t(members.size());
+}
+
+//! Observer that makes a member arrive at an `await_group` when its computation completes.
+struct await_group_member : completion_observer {
+  //! The group we are part of.
+  await_group* group_{nullptr};
+  //! The index of the member in the group.
+  uint32_t index_{0};
+  //! Whether we are attached to the completion link of the member.
+  bool attached_{false};
+
+  await_group_member() {
+    on_complete_ = [](completion_observer* self) noexcept {
+      auto* member = static_cast<await_group_member*>(self);
+      member->group_->arrive(member->index_);
+    };
+  }
+};
+
+//! Creates the observers for the futures in `members`.
+template <typename... Futures> inline auto make_observers(std::tuple<Futures&...>&) {
+  return std::array<await_group_member, sizeof...(Futures)>{};
+}
+//! Creates the observers for the futures in `members`.
+template <typename Future> inline auto make_observers(std::span<Future>& members) {
+  return std::make_unique<await_group_member[]>(members.size());
+}
+
+/**
+ * @brief Frame that awaits a group of futures with a single suspension.
+ * @tparam Members Tuple of references to futures, or a span of futures.
+ * @tparam WaitForAll If `true`, the frame waits for all the futures, otherwise for the first one.
+ *
+ * On `spawn()`, this attaches an observer to the frames of all the futures. On `await()`, it
+ * first executes in place the computations that are still queued (only when waiting for all), and
+ * then suspends (at most once) until the group is done. Before returning, the group is detached
+ * from all the frames.
+ *
+ * The futures are not awaited by this frame; after this frame is awaited, calling `await()` on the
+ * completed futures will not block and will not switch threads.
+ */
+template <typename Members, bool WaitForAll> struct await_group_frame {
+  //! For `when_all` we don't return anything; for `when_any` we return the index of the future
+  //! (`empty_group_index` if there are no futures).
+  using result_t = std::conditional_t<WaitForAll, void, std::size_t>;
+
+  explicit await_group_frame(Members members)
+      : members_(members), group_(member_count(members_), WaitForAll),
+        observers_(make_observers(members_)) {}
+
+  //! Start observing the completion of all the futures.
+  void spawn() {
+    for_each_member(members_, [this](auto& frame, uint32_t index) {
+      auto& observer = observers_[index];
+      observer.group_ = &group_;
+      observer.index_ = index;
+      observer.attached_ = frame.completion().attach(&observer);
+      if (!observer.attached_)
+        group_.arrive(index);
+    });
+  }
+
+  //! Await for the group to be done.
+  result_t await() {
+    // Execute in place the computations that haven't started yet.
+    // For `when_any`, we don't want to delay the completion by the execution of a single member.
+    if constexpr (WaitForAll)
+      for_each_member(members_,
+                      [](auto& frame, uint32_t) { (void)frame.execute_inplace_if_queued(); });
+    // Suspend at most once, until the group is done.
+    group_.wait();
+    // Ensure that no frame will touch the group after this point.
+    for_each_member(members_, [this](auto& frame, uint32_t index) {
+      if (observers_[index].attached_)
+        (void)frame.completion().detach(&observers_[index]);
+    });
+
+    if constexpr (!WaitForAll) {
+      // Without members, the group is done from the start, and nobody arrived.
+      uint32_t index = group_.first_arrived();
+      return index == await_group::no_index ? empty_group_index : std::size_t(index);
+    }
+  }
+
+private:
+  using observers_t = decltype(make_observers(std::declval<Members&>()));
+
+  //! The futures that we are observing.
+  Members members_;
+  //! The shared completion state.
+  await_group group_;
+  //! The observers attached to the frames of the futures.
+  observers_t observers_;
+};
+
+} // namespace concore2full::detail
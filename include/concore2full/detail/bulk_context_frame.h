@@ -0,0 +1,82 @@
+#pragma once
+
+#include "concore2full/detail/bulk_spawn_frame_base.h"
+#include "concore2full/detail/bulk_spawn_frame_full.h"
+
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace concore2full::detail {
+
+//! The frame owned by a `bulk_context`, reused by all the bulk spawns made through the context.
+struct bulk_context_frame {
+  //! The function object for the current bulk spawn; owned by the corresponding future.
+  void* fn_{nullptr};
+  //! True between the spawn and the await of a bulk spawn made with this frame.
+  bool armed_{false};
+  //! The base frame for the bulk spawn operation, containing implementation details.
+  bulk_spawn_frame_base base_frame_;
+  // Note: we occupy more space after `base_frame_` to store the tasks and the thread suspension.
+
+  //! Returns the frame corresponding to the given interface of the base frame.
+  static bulk_context_frame* from_base(concore2full_bulk_spawn_frame* frame) noexcept {
+    char* p = reinterpret_cast<char*>(frame);
+    return reinterpret_cast<bulk_context_frame*>(p - offsetOf(&bulk_context_frame::base_frame_));
+  }
+};
+
+/**
+ * @brief Frame holder for a bulk spawn made through a `bulk_context`.
+ * @tparam Fn The type of the function to be executed.
+ * @tparam Chunked True if `Fn` is called with ranges of indices [begin, end).
+ *
+ * Holds the function object; the rest of the state is in the frame owned by the context.
+ */
+template <typename Fn, bool Chunked> struct bulk_context_holder {
+  using result_t = void;
+
+  bulk_context_holder(bulk_context_frame& frame, int64_t count, int64_t grain, Fn&& f)
+      : f_(std::forward<Fn>(f)), frame_(frame), count_(count), grain_(grain) {}
+
+  bulk_context_holder(bulk_context_holder&&) = delete;
+  bulk_context_holder(const bulk_context_holder&) = delete;
+
+  void spawn() {
+    assert(!frame_.armed_ && "the previous bulk spawn on this context was not awaited");
+    frame_.armed_ = true;
+    frame_.fn_ = std::addressof(f_);
+    auto& base = frame_.base_frame_;
+    base.spawn_chunked(count_, grain_, &to_execute_range, *base.pool_);
+  }
+  void await() {
+    frame_.base_frame_.await();
+    frame_.armed_ = false;
+  }
+
+private:
+  //! The user function to execute.
+  Fn f_;
+  //! The frame of the context.
+  bulk_context_frame& frame_;
+  //! The number of indices to execute.
+  int64_t count_;
+  //! The grain for chunked execution; zero for automatic, `per_index_grain` if not chunked.
+  int64_t grain_;
+
+  static void to_execute_range(concore2full_bulk_spawn_frame* frame, uint64_t begin, uint64_t end,
+                               void*) noexcept {
+    auto& f = *static_cast<std::remove_reference_t<Fn>*>(bulk_context_frame::from_base(frame)->fn_);
+    if constexpr (Chunked) {
+      std::invoke(f, int64_t(begin), int64_t(end));
+    } else {
+      for (uint64_t i = begin; i < end; i++)
+        std::invoke(f, i);
+    }
+  }
+};
+
+} // namespace concore2full::detail
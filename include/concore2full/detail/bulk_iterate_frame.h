@@ -0,0 +1,80 @@
+#pragma once
+
+#include "concore2full/detail/bulk_spawn_frame_base.h"
+#include "concore2full/detail/bulk_spawn_frame_full.h"
+#include "concore2full/detail/raw_delete.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+
+namespace concore2full::detail {
+
+/**
+ * @brief Represents the frame for a bulk iterate operation.
+ * @tparam Fn The type of the function executing a step, called as `f(iteration, index)`.
+ *
+ * Same as a bulk spawn, but the threads of execution are kept alive for all the iterations; they
+ * are synchronized at the end of each iteration by a barrier.
+ */
+template <typename Fn> struct bulk_iterate_frame {
+  //! The user function to execute for each iteration and index.
+  Fn f_;
+  //! The number of iterations.
+  uint64_t iterations_;
+  //! The base frame for the bulk spawn operation, containing implementation details.
+  bulk_spawn_frame_base base_frame_;
+  // Note: we occupy more space after `base_frame_` to store the tasks and the thread suspension.
+
+  using result_t = void;
+
+  void spawn() {
+    base_frame_.prepare(base_frame_.count_, bulk_spawn_frame_base::per_index_grain,
+                        &to_execute_range, *base_frame_.pool_);
+    base_frame_.set_iterations(iterations_);
+    base_frame_.start();
+  }
+  void await() { base_frame_.await(); }
+
+  //! Allocates a frame for executing `iterations` steps of `count` indices on `pool`.
+  static raw_unique_ptr<bulk_iterate_frame> allocate(thread_pool& pool, int64_t count,
+                                                     int64_t iterations, Fn&& f) {
+    size_t size_base_frame = bulk_spawn_frame_base::frame_size(count, pool);
+    size_t total_size =
+        sizeof(bulk_iterate_frame) - sizeof(bulk_spawn_frame_base) + size_base_frame;
+    void* p = operator new(total_size);
+    try {
+      return raw_unique_ptr<bulk_iterate_frame>{
+          new (p) bulk_iterate_frame(pool, count, iterations, std::forward<Fn>(f))};
+    } catch (...) {
+      operator delete(p);
+      throw;
+    }
+  }
+
+  bulk_iterate_frame(bulk_iterate_frame&&) = delete;
+  bulk_iterate_frame(const bulk_iterate_frame&) = delete;
+
+private:
+  bulk_iterate_frame(thread_pool& pool, int64_t count, int64_t iterations, Fn&& f)
+      : f_(std::forward<Fn>(f)), iterations_(uint64_t(iterations)) {
+    base_frame_.count_ = count;
+    base_frame_.pool_ = &pool;
+  }
+
+  //! Executes the indices [begin, end); a chunk never spans multiple iterations.
+  static void to_execute_range(concore2full_bulk_spawn_frame* frame, uint64_t begin, uint64_t end,
+                               void*) noexcept {
+    char* p = reinterpret_cast<char*>(frame);
+    bulk_iterate_frame* self =
+        reinterpret_cast<bulk_iterate_frame*>(p - offsetOf(&bulk_iterate_frame::base_frame_));
+
+    uint64_t count = self->base_frame_.count_;
+    uint64_t iteration = begin / count;
+    for (uint64_t i = begin - iteration * count; i < end - iteration * count; i++)
+      std::invoke(self->f_, int64_t(iteration), int64_t(i));
+  }
+};
+
+} // namespace concore2full::detail
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "concore2full/detail/bulk_spawn_frame_base.h"
+#include "concore2full/detail/bulk_spawn_frame_full.h"
+#include "concore2full/detail/raw_delete.h"
+
+#include <functional>
+#include <memory>
+#include <utility>
+
+namespace concore2full::detail {
+
+/**
+ * @brief Represents the frame for a bulk reduce operation.
+ * @tparam T The type of the result.
+ * @tparam Map The type of the function that maps an index to a value.
+ * @tparam Combine The type of the function that combines two values.
+ *
+ * Each thread of execution accumulates into its own partial result, stored in the bulk frame, on
+ * its own cache lines. As the threads of execution finish, the partial results are combined in a
+ * tree; the thread that finishes last combines the last two partial results.
+ */
+template <typename T, typename Map, typename Combine> struct bulk_reduce_frame {
+  static_assert(alignof(T) <= 64, "over-aligned types cannot be used as bulk_reduce results");
+
+  //! The identity value for the combine function; the initial value of the partial results.
+  T identity_;
+  //! The function that maps an index to a value.
+  Map map_;
+  //! The function that combines two values.
+  Combine combine_;
+  //! The base frame for the bulk spawn operation, containing implementation details.
+  bulk_spawn_frame_base base_frame_;
+  // Note: we occupy more space after `base_frame_` to store the tasks and the partial results.
+
+  using result_t = T;
+
+  void spawn() {
+    base_frame_.prepare(base_frame_.count_, bulk_spawn_frame_base::per_index_grain,
+                        &to_execute_range, *base_frame_.pool_, &to_combine, sizeof(T));
+    for (uint32_t i = 0; i < base_frame_.task_count_; i++)
+      new (base_frame_.partial(i)) T(identity_);
+    base_frame_.start();
+  }
+
+  T await() {
+    base_frame_.await();
+    // All the partial results are combined into the first one.
+    T result = std::move(*partial(0));
+    for (uint32_t i = 0; i < base_frame_.task_count_; i++)
+      partial(i)->~T();
+    return result;
+  }
+
+  //! Allocates a frame for reducing `count` values on `pool`.
+  static raw_unique_ptr<bulk_reduce_frame> allocate(thread_pool& pool, int64_t count, T identity,
+                                                    Map map, Combine combine) {
+    size_t size_base_frame = bulk_spawn_frame_base::frame_size(count, pool, sizeof(T));
+    size_t total_size = sizeof(bulk_reduce_frame) - sizeof(bulk_spawn_frame_base) + size_base_frame;
+    void* p = operator new(total_size);
+    try {
+      return raw_unique_ptr<bulk_reduce_frame>{new (p) bulk_reduce_frame(
+          pool, count, std::move(identity), std::move(map), std::move(combine))};
+    } catch (...) {
+      operator delete(p);
+      throw;
+    }
+  }
+
+  bulk_reduce_frame(bulk_reduce_frame&&) = delete;
+  bulk_reduce_frame(const bulk_reduce_frame&) = delete;
+
+private:
+  bulk_reduce_frame(thread_pool& pool, int64_t count, T identity, Map map, Combine combine)
+      : identity_(std::move(identity)), map_(std::move(map)), combine_(std::move(combine)) {
+    base_frame_.count_ = count;
+    base_frame_.pool_ = &pool;
+  }
+
+  T* partial(uint32_t index) noexcept { return static_cast<T*>(base_frame_.partial(index)); }
+
+  static bulk_reduce_frame* from_base(concore2full_bulk_spawn_frame* frame) noexcept {
+    char* p = reinterpret_cast<char*>(frame);
+    return reinterpret_cast<bulk_reduce_frame*>(p - offsetOf(&bulk_reduce_frame::base_frame_));
+  }
+
+  //! Accumulates the values for indices [begin, end) into `partial`.
+  static void to_execute_range(concore2full_bulk_spawn_frame* frame, uint64_t begin, uint64_t end,
+                               void* partial) noexcept {
+    bulk_reduce_frame* self = from_base(frame);
+    T& acc = *static_cast<T*>(partial);
+    for (uint64_t i = begin; i < end; i++)
+      acc = std::invoke(self->combine_, std::move(acc), std::invoke(self->map_, int64_t(i)));
+  }
+
+  //! Combines partial result `src` into `dst`.
+  static void to_combine(concore2full_bulk_spawn_frame* frame, void* dst, void* src) noexcept {
+    bulk_reduce_frame* self = from_base(frame);
+    T& d = *static_cast<T*>(dst);
+    d = std::invoke(self->combine_, std::move(d), std::move(*static_cast<T*>(src)));
+  }
+};
+
+} // namespace concore2full::detail
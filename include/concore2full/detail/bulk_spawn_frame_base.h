@@ -5,6 +5,7 @@
 #include "concore2full/detail/catomic.h"
 #include "concore2full/detail/core_types.h"
 #include "concore2full/this_thread.h"
+#include "concore2full/thread_pool.h"
 
 #include <memory>
 #include <type_traits>
@@ -12,8 +13,24 @@
 namespace concore2full::detail {
 
 struct concore2full_bulk_spawn_task;
-
-//! Basic structure needed to perform a *bulk spawn* operation.
+struct bulk_range_slot;
+
+//! Type of a function called to execute the work items in range [`begin`, `end`).
+//! `partial` is the partial result of the calling thread of execution, for reductions.
+using bulk_range_function_t = void (*)(concore2full_bulk_spawn_frame*, uint64_t begin,
+                                       uint64_t end, void* partial);
+
+//! Type of a function that combines partial result `src` into partial result `dst`.
+using bulk_combine_function_t = void (*)(concore2full_bulk_spawn_frame*, void* dst, void* src);
+
+/**
+ * @brief Basic structure needed to perform a *bulk spawn* operation.
+ *
+ * Instead of creating one task per index, we create one task per worker of the thread pool (plus
+ * one for the awaiting thread). Each task owns a range of indices; it executes the indices from the
+ * front of its range, and, when the range is exhausted, it steals the back half of the range of
+ * another task. This way, the memory needed for the frame doesn't depend on the number of indices.
+ */
 struct bulk_spawn_frame_base {
 
   using interface_t = concore2full_bulk_spawn_frame;
@@ -25,11 +42,77 @@ struct bulk_spawn_frame_base {
   }
   interface_t* to_interface() { return reinterpret_cast<interface_t*>(this); }
 
+  //! The maximum number of threads of execution of a bulk spawn, regardless of the parallelism of
+  //! the thread pool; bounds the frame size.
+  static constexpr uint32_t max_task_count = 256;
+
   //! Returns the frame size we need for storing this object, given the number of work items.
-  static uint64_t frame_size(int32_t count);
+  //! The result is an upper bound valid for all thread pools, so the frame can be spawned on any
+  //! thread pool.
+  static uint64_t frame_size(int64_t count);
+  //! Returns the frame size we need for storing this object, given the number of work items, and
+  //! the thread pool that we spawn on.
+  static uint64_t frame_size(int64_t count, thread_pool& pool);
+  //! Returns the frame size we need for storing this object, given the number of work items, the
+  //! thread pool that we spawn on, and the size of the partial results.
+  static uint64_t frame_size(int64_t count, thread_pool& pool, uint32_t partial_size);
+
+  //! Asynchronously executes `f` for indices in range [0, `count`), on the current thread pool.
+  void spawn(int64_t count, concore2full_bulk_spawn_function_t f);
+  //! Asynchronously executes `f` for indices in range [0, `count`), on `pool`.
+  void spawn(int64_t count, concore2full_bulk_spawn_function_t f, thread_pool& pool);
+  //! The grain for work executed per index: each thread of execution claims a fraction of its
+  //! remaining work items at a time, without measuring the time needed to execute them.
+  static constexpr int64_t per_index_grain = -1;
+
+  //! Asynchronously executes `f` for chunks of indices covering range [0, `count`), on `pool`.
+  //! Chunks have `grain` indices (except the last one), and start at multiples of `grain`; if
+  //! `grain` is zero, the chunk sizes are chosen based on the time needed to execute them. See
+  //! also `per_index_grain`.
+  void spawn_chunked(int64_t count, int64_t grain, bulk_range_function_t f, thread_pool& pool);
+
+  //! Prepares the frame for executing `f` for chunks of indices, without starting the execution.
+  //! If `combine` is given, each thread of execution has a partial result of `partial_size` bytes,
+  //! which needs to be constructed (see `partial()`) before calling `start()`. The partial results
+  //! are combined together as the threads of execution finish; after `await()`, `partial(0)`
+  //! contains the combined result.
+  void prepare(int64_t count, int64_t grain, bulk_range_function_t f, thread_pool& pool,
+               bulk_combine_function_t combine = nullptr, uint32_t partial_size = 0);
+  //! Makes the prepared work execute `iterations` times, as supersteps; must be called between
+  //! `prepare()` and `start()`. The work items of superstep `s` have indices in range
+  //! [`s * count`, `(s + 1) * count`). All the work items of a superstep are executed before any
+  //! work item of the next superstep starts. The threads of execution are kept alive between
+  //! supersteps.
+  void set_iterations(uint64_t iterations);
+  //! Records the workers executing the tasks into `worker_lines`, and uses the recorded values to
+  //! enqueue the tasks on the work lines owned by the same workers; must be called between
+  //! `prepare()` and `start()`. `worker_lines` needs to have `task_count_` elements; negative
+  //! values mean no worker.
+  void set_affinity(int32_t* worker_lines) noexcept { affinity_ = worker_lines; }
+  //! Obtains the stacks for the threads of execution from `stacks`, instead of the resource of the
+  //! thread pool; must be called between `prepare()` and `start()`.
+  void set_stack_resource(stack::stack_resource& stacks) noexcept { stacks_ = &stacks; }
+  //! Uses stacks of `size_class` for the threads of execution; must be called between `prepare()`
+  //! and `start()`.
+  void set_stack_size_class(stack::stack_size_class size_class) noexcept {
+    size_class_ = size_class;
+  }
+  //! Starts executing the work prepared with `prepare()`.
+  void start();
+
+  //! Requests that no work items with indices greater than `index` are executed. Work items that
+  //! are not yet started are skipped; the ones already running are completed. Can be called
+  //! concurrently from the work items; the lowest index wins. Not supported with supersteps.
+  void stop_after(uint64_t index) noexcept;
+  //! Returns one past the index of the last work item that needs to be executed.
+  uint64_t limit() const noexcept { return limit_.load(std::memory_order_relaxed); }
+
+  //! Range function that calls `user_function_` for each index in the range.
+  static void execute_each(concore2full_bulk_spawn_frame* frame, uint64_t begin, uint64_t end,
+                           void* partial) noexcept;
 
-  //! Asynchronously executes `f` for indices in range [0, `count`).
-  void spawn(int32_t count, concore2full_bulk_spawn_function_t f);
+  //! Returns the partial result of the thread of execution with index `index`.
+  void* partial(uint32_t index) noexcept { return partials_ + index * partial_stride_; }
 
   //! Await the async computation started by `spawn` to be finished.
   void await();
@@ -37,7 +120,27 @@ struct bulk_spawn_frame_base {
 public:
   // private:
   //! The number of work item for the bulk operation.
-  uint32_t count_;
+  uint64_t count_;
+
+  //! The number of tasks (threads of execution) that execute the work items.
+  uint32_t task_count_;
+
+  //! The number of work items in a chunk; zero if chunk sizes are chosen automatically.
+  uint64_t grain_;
+  //! True if chunk sizes are adjusted based on the time needed to execute them.
+  bool timed_chunks_;
+
+  //! The number of supersteps to execute; 1 for a regular bulk spawn.
+  uint64_t iterations_;
+
+  //! The superstep currently being executed; acts as the sense of the superstep barrier.
+  std::atomic<uint64_t> current_step_;
+
+  //! The number of work items of the current superstep that were executed.
+  std::atomic<uint64_t> step_done_items_;
+
+  //! Work items with indices greater or equal to this are skipped; lowered by `stop_after()`.
+  std::atomic<uint64_t> limit_;
 
   //! The number of started tasks.
   std::atomic<uint32_t> started_tasks_;
@@ -47,16 +150,42 @@ public:
   //! The number of finalized tasks.
   std::atomic<uint32_t> finalized_tasks_;
 
-  //! The user function to be called to execute the async work.
+  //! The user function to be called to execute the async work, for each index.
   concore2full_bulk_spawn_function_t user_function_;
 
+  //! The function to be called to execute a chunk of work items.
+  bulk_range_function_t range_function_;
+
+  //! The function that combines partial results; null if there are no partial results.
+  bulk_combine_function_t combine_function_;
+
+  //! The distance between partial results of consecutive tasks.
+  uint32_t partial_stride_;
+
+  //! The partial results of the tasks, for reductions; each one on its own cache lines.
+  char* partials_;
+
+  //! The thread pool on which the work is spawned.
+  thread_pool* pool_;
+
+  //! The workers that executed the tasks, for affinity; null if not used.
+  int32_t* affinity_;
+
+  //! The resource used to obtain the stacks for the threads of execution.
+  stack::stack_resource* stacks_;
+  //! The size class of the stacks for the threads of execution.
+  stack::stack_size_class size_class_;
+
   //! The tasks for each work item.
   concore2full_bulk_spawn_task* tasks_;
 
-  //! The data needed to interact with each thread of execution; at position `_count + 1` we store
-  //! the information about the thread doing the await.
+  //! The data needed to interact with each thread of execution; at position `task_count_` we
+  //! store the information about the thread doing the await.
   catomic<continuation_t>* threads_;
 
+  //! The ranges of indices owned by each task.
+  bulk_range_slot* ranges_;
+
   // More data will follow here, depending on the number of work items.
 
 private:
@@ -66,8 +195,28 @@ private:
   catomic<continuation_t>* extract_continuation();
   //! Called when a a thread finishes work and wants to exit the spawn scope.
   void finalize_thread_of_execution(bool is_last_thread);
+  //! Execute the work of the task with index `task_index`, for all the supersteps.
+  void execute_work(uint32_t task_index);
+  //! Execute work items for all the supersteps, waiting at the end of each superstep for the other
+  //! threads of execution to finish it.
+  void execute_supersteps(uint32_t task_index);
+  //! Called after `n` work items starting at `begin` are executed; the thread executing the last
+  //! work items of a superstep starts the next superstep.
+  void on_items_done(uint64_t begin, uint64_t n);
+  //! Evenly divides the work items between the tasks, adding `offset` to the indices.
+  void assign_ranges(uint64_t offset);
+  //! Execute work items, starting with the range owned by the task with index `task_index`, and
+  //! then stealing from the other tasks, until there are no more work items.
+  void execute_ranges(uint32_t task_index);
+  //! Combines the partial result of the task with index `task_index` into the partial results of
+  //! the other tasks, going up in a combining tree, as long as we are the last one to arrive.
+  void combine_partials(uint32_t task_index);
+  //! Returns the number of tasks we use for `count` work items on `pool`.
+  static uint32_t task_count(int64_t count, thread_pool& pool);
+  //! Returns the frame size for `tasks` tasks, with partial results of `partial_size` bytes.
+  static uint64_t frame_size_for_tasks(uint64_t tasks, uint32_t partial_size);
   //! The task function that executes the async work.
-  static void execute_bulk_spawn_task(concore2full_task* t, int) noexcept;
+  static void execute_bulk_spawn_task(concore2full_task* t, int worker_index) noexcept;
 };
 
 } // namespace concore2full::detail
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "concore2full/affinity_partitioner.h"
 #include "concore2full/c/spawn.h"
 #include "concore2full/detail/bulk_spawn_frame_base.h"
 #include "concore2full/detail/raw_delete.h"
@@ -10,9 +11,16 @@
 namespace concore2full::detail {
 
 //! Represents the frame for a bulk spawn operation.
-template <typename Fn> struct bulk_spawn_frame_full {
+//! If `Chunked` is true, `Fn` is called with ranges of indices [begin, end) instead of indices.
+template <typename Fn, bool Chunked = false> struct bulk_spawn_frame_full {
   //! The use function to execute multiple times in parallel.
   Fn f_;
+  //! The partitioner used to keep the affinity of the work to the workers; may be null.
+  affinity_partitioner* partitioner_{nullptr};
+  //! The resource used to obtain the stacks; null for the resource of the thread pool.
+  stack::stack_resource* stacks_{nullptr};
+  //! The size class of the stacks for the threads of execution.
+  stack::stack_size_class size_class_{stack::stack_size_class::normal};
   //! The base frame for the bulk spawn operation, containing implementation details.
   bulk_spawn_frame_base base_frame_;
   // Note: we occupy more space after `base_frame_` to store the tasks and the thread suspension.
@@ -20,19 +28,38 @@ template <typename Fn> struct bulk_spawn_frame_full {
   using result_t = void;
 
   void spawn() {
-    base_frame_.spawn(base_frame_.count_, &detail::bulk_spawn_frame_full<Fn>::to_execute);
+    auto& base = base_frame_;
+    if constexpr (Chunked) {
+      base.prepare(base.count_, base.grain_, &to_execute_range, *base.pool_);
+    } else {
+      base.user_function_ = &to_execute;
+      base.prepare(base.count_, bulk_spawn_frame_base::per_index_grain,
+                   &bulk_spawn_frame_base::execute_each, *base.pool_);
+    }
+    if (partitioner_)
+      base.set_affinity(partitioner_->worker_lines(base.task_count_));
+    if (stacks_)
+      base.set_stack_resource(*stacks_);
+    base.set_stack_size_class(size_class_);
+    base.start();
   }
   void await() { base_frame_.await(); }
 
-  //! Allocates a frame for bulk spawning `count` tasks that call `f`.
-  static raw_unique_ptr<bulk_spawn_frame_full> allocate(int count, Fn&& f) {
-    size_t size_base_frame = bulk_spawn_frame_base::frame_size(count);
+  //! Allocates a frame for bulk spawning `count` tasks that call `f` on `pool`.
+  //! `grain` is only used for chunked bulk spawns. If `stacks` is given, the stacks are obtained
+  //! from it, instead of the resource of `pool`; the stacks are of `size_class`.
+  static raw_unique_ptr<bulk_spawn_frame_full>
+  allocate(thread_pool& pool, int64_t count, Fn&& f, int64_t grain = 0,
+           affinity_partitioner* partitioner = nullptr, stack::stack_resource* stacks = nullptr,
+           stack::stack_size_class size_class = stack::stack_size_class::normal) {
+    size_t size_base_frame = bulk_spawn_frame_base::frame_size(count, pool);
     size_t total_size =
         sizeof(bulk_spawn_frame_full) - sizeof(bulk_spawn_frame_base) + size_base_frame;
     void* p = operator new(total_size);
     try {
       return raw_unique_ptr<bulk_spawn_frame_full>{
-          new (p) bulk_spawn_frame_full(count, std::forward<Fn>(f))};
+          new (p) bulk_spawn_frame_full(pool, count, grain, std::forward<Fn>(f), partitioner,
+                                        stacks, size_class)};
     } catch (...) {
       operator delete(p);
       throw;
@@ -51,9 +78,25 @@ template <typename Fn> struct bulk_spawn_frame_full {
     std::invoke(std::forward<Fn>(self->f_), index);
   }
 
+  //! The function called by the chunked bulk spawn to execute a range of indices.
+  static void to_execute_range(concore2full_bulk_spawn_frame* frame, uint64_t begin, uint64_t end,
+                               void*) noexcept {
+    char* p = reinterpret_cast<char*>(frame);
+    bulk_spawn_frame_full* self =
+        reinterpret_cast<bulk_spawn_frame_full*>(p - offsetOf(&bulk_spawn_frame_full::base_frame_));
+
+    std::invoke(std::forward<Fn>(self->f_), int64_t(begin), int64_t(end));
+  }
+
 private:
-  explicit bulk_spawn_frame_full(int count, Fn&& f) : f_(std::forward<Fn>(f)) {
+  explicit bulk_spawn_frame_full(thread_pool& pool, int64_t count, int64_t grain, Fn&& f,
+                                 affinity_partitioner* partitioner, stack::stack_resource* stacks,
+                                 stack::stack_size_class size_class)
+      : f_(std::forward<Fn>(f)), partitioner_(partitioner), stacks_(stacks),
+        size_class_(size_class) {
     base_frame_.count_ = count;
+    base_frame_.grain_ = grain;
+    base_frame_.pool_ = &pool;
   }
 };
 
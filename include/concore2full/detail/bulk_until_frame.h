@@ -0,0 +1,82 @@
+#pragma once
+
+#include "concore2full/detail/bulk_spawn_frame_base.h"
+#include "concore2full/detail/bulk_spawn_frame_full.h"
+#include "concore2full/detail/raw_delete.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+
+namespace concore2full::detail {
+
+/**
+ * @brief Represents the frame for a bulk spawn operation that can stop early.
+ * @tparam Fn The type of the function to execute, called as `f(index)`, returning `bool`.
+ *
+ * When `f(index)` returns true, the work items with greater indices are no longer needed: the ones
+ * not yet started are skipped, without being executed. The work items with smaller indices are
+ * still executed, so that the result is the smallest index for which `f` returns true.
+ */
+template <typename Fn> struct bulk_until_frame {
+  //! The user function to execute for each index.
+  Fn f_;
+  //! The base frame for the bulk spawn operation, containing implementation details.
+  bulk_spawn_frame_base base_frame_;
+  // Note: we occupy more space after `base_frame_` to store the tasks and the thread suspension.
+
+  using result_t = int64_t;
+
+  void spawn() {
+    base_frame_.prepare(base_frame_.count_, bulk_spawn_frame_base::per_index_grain,
+                        &to_execute_range, *base_frame_.pool_);
+    base_frame_.start();
+  }
+
+  //! Returns the smallest index for which `f` returned true, or `count` if there is no such index.
+  int64_t await() {
+    base_frame_.await();
+    uint64_t limit = base_frame_.limit();
+    return limit == UINT64_MAX ? int64_t(base_frame_.count_) : int64_t(limit - 1);
+  }
+
+  //! Allocates a frame for executing `f` for `count` indices on `pool`.
+  static raw_unique_ptr<bulk_until_frame> allocate(thread_pool& pool, int64_t count, Fn&& f) {
+    size_t size_base_frame = bulk_spawn_frame_base::frame_size(count, pool);
+    size_t total_size = sizeof(bulk_until_frame) - sizeof(bulk_spawn_frame_base) + size_base_frame;
+    void* p = operator new(total_size);
+    try {
+      return raw_unique_ptr<bulk_until_frame>{
+          new (p) bulk_until_frame(pool, count, std::forward<Fn>(f))};
+    } catch (...) {
+      operator delete(p);
+      throw;
+    }
+  }
+
+  bulk_until_frame(bulk_until_frame&&) = delete;
+  bulk_until_frame(const bulk_until_frame&) = delete;
+
+private:
+  bulk_until_frame(thread_pool& pool, int64_t count, Fn&& f) : f_(std::forward<Fn>(f)) {
+    base_frame_.count_ = count;
+    base_frame_.pool_ = &pool;
+  }
+
+  //! Executes the indices [begin, end), stopping as soon as the remaining ones are not needed.
+  static void to_execute_range(concore2full_bulk_spawn_frame* frame, uint64_t begin, uint64_t end,
+                               void*) noexcept {
+    char* p = reinterpret_cast<char*>(frame);
+    bulk_until_frame* self =
+        reinterpret_cast<bulk_until_frame*>(p - offsetOf(&bulk_until_frame::base_frame_));
+
+    auto& base = self->base_frame_;
+    for (uint64_t i = begin; i < end && i < base.limit(); i++) {
+      if (std::invoke(self->f_, int64_t(i)))
+        base.stop_after(i);
+    }
+  }
+};
+
+} // namespace concore2full::detail
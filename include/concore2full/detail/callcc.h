@@ -4,8 +4,9 @@
 #include "concore2full/detail/core_types.h"
 #include "concore2full/detail/create_stackfull_coroutine.h"
 #include "concore2full/profiling.h"
-#include "concore2full/stack/simple_stack_allocator.h"
+#include "concore2full/stack/pooled_stack_allocator.h"
 #include "concore2full/stack/stack_allocator.h"
+#include "concore2full/stack/stack_resource.h"
 
 #include <context_core_api.h>
 
@@ -35,7 +36,7 @@ inline continuation_t callcc(std::allocator_arg_t, stack::stack_allocator auto&&
 /// The return continuation of the given function will be used to call the destruction of the
 /// stackfull coroutine.
 ///
-/// If stack allocator is not provided, a default `simple_stack_allocator` will be used.
+/// If stack allocator is not provided, a default `pooled_stack_allocator` will be used.
 ///
 /// @sa resume()
 inline continuation_t callcc(std::allocator_arg_t, stack::stack_allocator auto&& salloc,
@@ -45,7 +46,26 @@ inline continuation_t callcc(std::allocator_arg_t, stack::stack_allocator auto&&
                                             std::forward<decltype(f)>(f));
 }
 inline continuation_t callcc(context_function auto&& f) {
-  return callcc(std::allocator_arg, stack::simple_stack_allocator(), std::forward<decltype(f)>(f));
+  return callcc(std::allocator_arg, stack::pooled_stack_allocator(), std::forward<decltype(f)>(f));
+}
+//! Same as `callcc(f)`, but the stack is obtained from `stacks`.
+inline continuation_t callcc(stack::stack_resource& stacks, context_function auto&& f) {
+  return callcc(std::allocator_arg, stack::resource_stack_allocator(stacks),
+                std::forward<decltype(f)>(f));
+}
+//! The size class of the stacks of the coroutines that the library creates to switch threads. These
+//! coroutines must not execute any other work: they only hand over continuations and wait.
+constexpr stack::stack_size_class switch_stack_class = stack::stack_size_class::small;
+//! The size class of the stacks of the coroutines that help the thread pool while waiting (e.g.,
+//! with `thread_pool::offer_help_until()`); the tasks of the pool are executed inline on them, so
+//! they need regular stacks.
+constexpr stack::stack_size_class helping_stack_class = stack::stack_size_class::normal;
+
+//! Same as `callcc(f)`, but a stack of `size_class` is obtained from `stacks`.
+inline continuation_t callcc(stack::stack_resource& stacks, stack::stack_size_class size_class,
+                             context_function auto&& f) {
+  return callcc(std::allocator_arg, stack::resource_stack_allocator(stacks, size_class),
+                std::forward<decltype(f)>(f));
 }
 
 //! Resumes the given continuation.
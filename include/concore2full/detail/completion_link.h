@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace concore2full::detail {
+
+//! An object that wants to be notified when a spawned computation completes.
+//! The observer needs to be kept alive until it is detached from the link it was attached to.
+struct completion_observer {
+  //! Called when the observed computation completes.
+  void (*on_complete_)(completion_observer* self) noexcept {nullptr};
+  //! The next observer of the same computation; implementation details.
+  completion_observer* next_{nullptr};
+  //! Set after the observer was notified; implementation details.
+  std::atomic<bool> notified_{false};
+};
+
+/**
+ * @brief Keeps track of the observers of a spawned computation.
+ *
+ * The frame of the computation calls `start_notify()` before releasing its state on completion,
+ * and `finish_notify()` after it. The observers use `attach()` and `detach()`.
+ *
+ * For an attached observer, exactly one of the following happens: `detach()` returns `true`, or
+ * the observer is notified. After `detach()` returns, the observer will not be touched anymore.
+ * `detach()` must be called for all the attached observers before they are destroyed.
+ */
+struct completion_link {
+  //! Attach `observer` to this link.
+  //! Returns `false` if the computation already completed; in this case `observer` is not attached.
+  bool attach(completion_observer* observer) noexcept;
+
+  //! Detach `observer` from this link, waiting for any in-flight notification to complete.
+  //! Returns `true` if `observer` was detached before being notified.
+  //! Must be called only if the previous `attach()` call for `observer` returned `true`.
+  bool detach(completion_observer* observer) noexcept;
+
+  //! Marks the completion of the computation; returns the list of observers to be notified.
+  completion_observer* start_notify() noexcept;
+
+  //! Notifies the observers returned by `start_notify()`, if any.
+  //! Doesn't touch the link; the frame holding the link may already be destroyed.
+  static void finish_notify(completion_observer* observers) noexcept;
+
+private:
+  //! Bit indicating that the list of observers is locked.
+  static constexpr uintptr_t locked_bit = 1;
+  //! Bit indicating that the computation has completed.
+  static constexpr uintptr_t completed_bit = 2;
+
+  //! The head of the list of observers, combined with the above bits.
+  std::atomic<uintptr_t> state_{0};
+
+  //! Locks the list of observers, if the computation is not completed; returns the unlocked state.
+  uintptr_t lock() noexcept;
+};
+
+} // namespace concore2full::detail
@@ -2,13 +2,16 @@
 
 #include "concore2full/c/spawn.h"
 #include "concore2full/c/task.h"
+#include "concore2full/detail/completion_link.h"
 #include "concore2full/detail/callcc.h"
 #include "concore2full/detail/value_holder.h"
 #include "concore2full/profiling_atomic.h"
-#include "concore2full/suspend.h"
 #include "concore2full/this_thread.h"
+#include "concore2full/thread_pool.h"
 
+#include <atomic>
 #include <memory>
+#include <stop_token>
 #include <type_traits>
 
 namespace concore2full::detail {
@@ -25,12 +28,21 @@ struct copyable_spawn_frame_base {
   }
   interface_t* to_interface() { return reinterpret_cast<interface_t*>(this); }
 
-  //! Asynchronously executes `f`.
+  //! Asynchronously executes `f` on the current thread pool.
   void spawn(concore2full_spawn_function_t f);
+  //! Asynchronously executes `f` on `pool`.
+  void spawn(concore2full_spawn_function_t f, thread_pool& pool);
 
   //! Await the async computation started by `spawn` to be finished.
   void await();
 
+  //! If the async computation is still queued, execute it on the current thread.
+  //! Returns `true` if the computation was executed here.
+  bool execute_inplace_if_queued();
+
+  //! Returns the link used to observe the completion of the computation.
+  completion_link& completion() noexcept { return completion_; }
+
 private:
   //! Describes how to view the spawn data as a task.
   struct concore2full_task task_;
@@ -49,12 +61,25 @@ private:
   //! The user function to be called to execute the async work.
   concore2full_spawn_function_t user_function_;
 
-  //! Token that will wake any suspended threads of execution.
-  suspend_token suspend_token_;
+  //! Link used to observe the completion of the computation.
+  completion_link completion_;
+
+  //! Requested when the computation completes, waking up the threads parked by late awaiters.
+  std::stop_source done_;
+
+  //! The late awaiters waiting for the computation to complete, linked through `next_`.
+  std::atomic<concore2full_task*> late_awaiters_{nullptr};
+
+  //! The thread pool on which the computation is spawned.
+  thread_pool* pool_{nullptr};
 
 private:
   //! Called when the spawned work is completed.
   continuation_t on_async_complete(continuation_t c);
+  //! Parks the current control flow until the computation completes; used by late awaiters.
+  void park_late_awaiter();
+  //! Resumes all the late awaiters, in one batch.
+  void resume_late_awaiters() noexcept;
   //! The task function that executes the spawned work.
   static void execute_spawn_task(concore2full_task* task, int) noexcept;
 };
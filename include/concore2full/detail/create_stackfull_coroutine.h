@@ -91,9 +91,11 @@ inline continuation_t create_stackfull_coroutine(stack::stack_allocator auto&& a
                                                  context_function auto&& f) {
   auto* control =
       allocate_stack(std::forward<decltype(allocator)>(allocator), std::forward<decltype(f)>(f));
+#if CONCORE2FULL_INSTRUMENTATION_LEVEL >= CONCORE2FULL_INSTRUMENTATION_FULL
   char name[32];
   snprintf(name, sizeof(name), "coro-%p", control->stack_begin());
   profiling::define_stack(control->stack_begin(), control->stack_end(), name);
+#endif
   profiling::zone_instant{CURRENT_LOCATION_N("callcc.make_fcontext")}.add_flow(as_value(control));
 
   // Create a context for running the new code.
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "concore2full/detail/frame_with_value.h"
+#include "concore2full/detail/spawn_frame_base.h"
+#include "concore2full/stop_token.h"
+#include "concore2full/thread_pool.h"
+
+#include <utility>
+
+namespace concore2full::detail {
+
+//! Same as `frame_with_value<spawn_frame_base, Fn>`, but the computation is spawned on the given
+//! thread pool, and is dropped if a stop is requested on the given token before it starts.
+//! If `stacks` is given, the stacks for the computation are obtained from it. The stack for the
+//! computation is of `size_class`.
+template <typename Fn> struct frame_with_options : frame_with_value<spawn_frame_base, Fn> {
+  using base_t = frame_with_value<spawn_frame_base, Fn>;
+
+  frame_with_options(thread_pool& pool, stop_token token, Fn&& f,
+                     stack::stack_resource* stacks = nullptr,
+                     stack::stack_size_class size_class = stack::stack_size_class::normal)
+      : base_t(std::forward<Fn>(f)), pool_(pool), token_(token), stacks_(stacks),
+        size_class_(size_class) {}
+
+  frame_with_options(frame_with_options&& other) = default;
+
+  //! Spawn the computation, that will execute `f_` if no stop is requested on the token.
+  void spawn() {
+    spawn_frame_base::spawn(&base_t::to_execute, pool_, token_, stacks_, size_class_);
+  }
+
+private:
+  //! The thread pool on which the computation is spawned.
+  thread_pool& pool_;
+  //! The token used to check if the computation needs to be dropped.
+  stop_token token_;
+  //! The resource used to obtain the stacks; null for the resource of the thread pool.
+  stack::stack_resource* stacks_;
+  //! The size class of the stack for the computation.
+  stack::stack_size_class size_class_;
+};
+
+} // namespace concore2full::detail
@@ -31,8 +31,16 @@ struct frame_with_value : FrameBase, value_holder<std::invoke_result_t<Fn>> {
     FrameBase::await();
     return value_holder_t::value();
   }
+  //! Same as `await()`, but the awaiting stack may be parked; see `spawn_frame_base`.
+  result_t await_parked() {
+    FrameBase::await_parked();
+    return value_holder_t::value();
+  }
+
+  //! Returns the base frame, implementing the core of the spawn logic.
+  FrameBase& base_frame() noexcept { return *this; }
 
-private:
+protected:
   //! Called by the backend implementation to execute the computation.
   static void to_execute(typename FrameBase::interface_t* frame) noexcept {
     auto* d = static_cast<frame_with_value*>(FrameBase::from_interface(frame));
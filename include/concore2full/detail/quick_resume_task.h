@@ -0,0 +1,39 @@
+#pragma once
+
+#include "concore2full/c/task.h"
+#include "concore2full/detail/callcc.h"
+#include "concore2full/detail/core_types.h"
+
+#include <atomic>
+
+namespace concore2full::detail {
+
+//! Task that resumes a suspended control flow on the thread that executes it.
+//! After the task is executed, `after_execute_` holds the continuation of the executing thread.
+//! The stack needed to switch to the suspended control flow is obtained from `stacks`.
+struct quick_resume_task : concore2full_task {
+  quick_resume_task(continuation_t c, stack::stack_resource& stacks) : cont_(c), stacks_(&stacks) {
+    task_function_ = &execute;
+  }
+
+  static void execute(struct concore2full_task* task, int worker_index) {
+    auto* self = static_cast<quick_resume_task*>(task);
+    callcc(*self->stacks_, switch_stack_class, [self](continuation_t c) -> continuation_t {
+      auto next = self->cont_;
+      // Store the continuation after the task execution.
+      self->after_execute_.store(c, std::memory_order_release);
+      // After this store, the `self` object can be destroyed.
+      // Jump to the point we want to resume.
+      return next;
+    });
+  }
+
+  //! The control flow to be resumed.
+  continuation_t cont_;
+  //! The resource used to obtain the stack for the switch.
+  stack::stack_resource* stacks_;
+  //! The continuation of the thread that executed the task.
+  std::atomic<continuation_t> after_execute_{nullptr};
+};
+
+} // namespace concore2full::detail
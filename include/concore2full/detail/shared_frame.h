@@ -17,6 +17,11 @@ template <typename Frame> struct shared_frame {
 
   result_t await() { return frame_->await(); }
 
+  result_t await_parked() { return frame_->await_parked(); }
+
+  //! Returns the base frame, implementing the core of the spawn logic.
+  auto& base_frame() noexcept { return frame_->base_frame(); }
+
 private:
   //! Wrap the frame object within a shared pointer.
   std::shared_ptr<Frame> frame_;
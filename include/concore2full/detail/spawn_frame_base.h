@@ -2,9 +2,12 @@
 
 #include "concore2full/c/spawn.h"
 #include "concore2full/c/task.h"
+#include "concore2full/detail/completion_link.h"
 #include "concore2full/detail/callcc.h"
 #include "concore2full/detail/value_holder.h"
+#include "concore2full/stop_token.h"
 #include "concore2full/this_thread.h"
+#include "concore2full/thread_pool.h"
 
 #include <memory>
 #include <type_traits>
@@ -23,18 +26,40 @@ struct spawn_frame_base {
   }
   interface_t* to_interface() { return reinterpret_cast<interface_t*>(this); }
 
-  //! Asynchronously executes `f`.
+  //! Asynchronously executes `f` on the current thread pool.
   void spawn(concore2full_spawn_function_t f);
+  //! Asynchronously executes `f` on `pool`; if `token` is stopped before `f` starts, `f` is not
+  //! executed. The stacks are obtained from `stacks`, or from the resource of `pool` if null; the
+  //! stack for `f` is of `size_class`.
+  void spawn(concore2full_spawn_function_t f, thread_pool& pool, stop_token token = {},
+             stack::stack_resource* stacks = nullptr,
+             stack::stack_size_class size_class = stack::stack_size_class::normal);
 
   //! Await the async computation started by `spawn` to be finished.
+  //! Throws `operation_cancelled` if the computation was dropped because of a stop request.
   void await();
+  //! Same as `await()`, but, while waiting, the stack of the awaiting coroutine may be parked (see
+  //! `stack::copying_stack_allocator`). Nothing may access the objects on that stack while waiting.
+  void await_parked();
+
+  //! If the async computation is still queued, execute it on the current thread.
+  //! Returns `true` if the computation was executed here.
+  bool execute_inplace_if_queued();
+
+  //! Returns the link used to observe the completion of the computation.
+  completion_link& completion() noexcept { return completion_; }
 
 private:
   //! Describes how to view the spawn data as a task.
   struct concore2full_task task_;
 
   //! The state of the computation, with respect to reaching the await point.
-  std::atomic<uint32_t> sync_state_;
+  //! Starts as "not spawned"; see `sync_state_values` in the implementation.
+  std::atomic<uint32_t> sync_state_{0};
+
+  //! The size class of the stack for the computation; placed here to fill the padding, as the
+  //! frame needs to fit in `concore2full_spawn_frame`.
+  stack::stack_size_class size_class_;
 
   //! The suspension point of the originator of the spawn.
   continuation_t originator_;
@@ -45,7 +70,24 @@ private:
   //! The user function to be called to execute the async work.
   concore2full_spawn_function_t user_function_;
 
+  //! Link used to observe the completion of the computation.
+  completion_link completion_;
+
+  //! Token indicating whether the computation should be dropped if not started yet.
+  stop_token stop_token_;
+
+  //! The thread pool on which the computation is spawned.
+  thread_pool* pool_{nullptr};
+
+  //! The resource used to obtain the stacks for the computation.
+  stack::stack_resource* stacks_;
+
 private:
+  //! Implements `await()` and `await_parked()`.
+  void await_impl(bool allow_parking);
+  //! Drop the computation, without executing it, if a stop was requested.
+  //! Returns `true` if the computation was dropped.
+  bool drop_if_stop_requested() noexcept;
   //! Called when the spawned work is completed.
   continuation_t on_async_complete(continuation_t c);
   //! The task function that executes the spawned work.
@@ -31,7 +31,7 @@ template <stack::stack_allocator S, context_function F> struct stack_control_str
   /// This will destroy this object and deallocate the stack.
   friend void destroy(stack_control_structure* record) {
     // Save needed data.
-    S allocator = std::move(record->allocator_);
+    std::decay_t<S> allocator = std::move(record->allocator_);
     stack::stack_t stack = record->stack_;
     // Destruct the object.
     record->~stack_control_structure();
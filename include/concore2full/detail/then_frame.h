@@ -0,0 +1,80 @@
+#pragma once
+
+#include "concore2full/detail/completion_link.h"
+#include "concore2full/detail/frame_with_value.h"
+#include "concore2full/detail/spawn_frame_base.h"
+
+#include <type_traits>
+#include <utility>
+
+namespace concore2full::detail {
+
+//! The function executed by a `then_frame`: awaits the predecessor and calls the continuation.
+template <typename Pred, typename Fn> struct then_function {
+  //! The future of the predecessor computation.
+  Pred pred_;
+  //! The continuation function.
+  Fn fn_;
+
+  decltype(auto) operator()() {
+    if constexpr (std::is_same_v<typename Pred::result_t, void>) {
+      pred_.await();
+      return fn_();
+    } else {
+      return fn_(pred_.await());
+    }
+  }
+};
+
+/**
+ * @brief Frame for a computation that starts when the computation of another future completes.
+ * @tparam Pred The type of the predecessor future; must be copyable.
+ * @tparam Fn The type of the continuation function.
+ *
+ * On `spawn()`, this attaches itself as an observer of the predecessor. When the predecessor
+ * completes, the thread completing it enqueues our computation; no thread needs to wait for the
+ * predecessor. If the predecessor is already complete, the computation is enqueued directly.
+ *
+ * If this frame is awaited before the predecessor completes, the computation is enqueued right
+ * away, and it will await the predecessor.
+ */
+template <typename Pred, typename Fn>
+struct then_frame : frame_with_value<spawn_frame_base, then_function<Pred, Fn>>,
+                    completion_observer {
+  using base_t = frame_with_value<spawn_frame_base, then_function<Pred, Fn>>;
+  using result_t = typename base_t::result_t;
+
+  then_frame(const Pred& pred, Fn fn) : base_t(then_function<Pred, Fn>{pred, std::move(fn)}) {}
+
+  //! Start observing the predecessor; our computation is spawned when the predecessor completes.
+  void spawn() {
+    on_complete_ = [](completion_observer* self) noexcept {
+      static_cast<then_frame*>(self)->base_t::spawn();
+    };
+    attached_ = predecessor_link().attach(this);
+    if (!attached_)
+      base_t::spawn();
+  }
+
+  //! Await the result of the continuation.
+  result_t await() {
+    // If the predecessor hasn't completed yet, don't wait for it to spawn our computation.
+    if (attached_ && predecessor_link().detach(this))
+      base_t::spawn();
+    return base_t::await();
+  }
+
+  //! Returns the base frame, implementing the core of the spawn logic.
+  spawn_frame_base& base_frame() noexcept { return *this; }
+
+private:
+  //! Whether we are attached to the completion link of the predecessor.
+  bool attached_{false};
+
+  //! Returns the link for observing the completion of the predecessor.
+  completion_link& predecessor_link() noexcept {
+    return this->f_.pred_.frame_holder().base_frame().completion();
+  }
+};
+
+} // namespace concore2full::detail
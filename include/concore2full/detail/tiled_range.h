@@ -0,0 +1,126 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+
+namespace concore2full::detail {
+
+/**
+ * @brief Maps a range of codes to tiles of an `N`-dimensional index box.
+ * @tparam N The number of dimensions.
+ *
+ * The tiles of the box are enumerated in Morton (Z-order): the bits of the tile coordinates are
+ * interleaved to form a linear code. Consecutive codes correspond to tiles that are close to each
+ * other, so a contiguous range of codes, executed by one worker, covers a compact region of the
+ * box.
+ *
+ * If the number of tiles in a dimension is not a power of two, some codes don't correspond to
+ * tiles; these are skipped. If this would make the number of codes more than `max_padding` times
+ * the number of tiles, or if the codes don't fit in 31 bits, the tiles are enumerated in row-major
+ * order instead (the first dimension varies the fastest), without skipped codes.
+ *
+ * If the size of the box is zero in any dimension, there are no tiles. Throws
+ * `std::invalid_argument` if a size is negative or a tile size is not positive, and
+ * `std::length_error` if the number of tiles doesn't fit in an `int`.
+ */
+template <std::size_t N> struct tiled_range {
+  //! The maximum ratio between the number of Morton codes and the number of tiles.
+  static constexpr int64_t max_padding = 4;
+
+  //! The size of the index box, in each dimension.
+  std::array<int, N> size_;
+  //! The size of a tile, in each dimension.
+  std::array<int, N> tile_;
+  //! The number of tiles, in each dimension.
+  std::array<int, N> tiles_;
+  //! The number of bits needed to represent the tile coordinates, in each dimension.
+  std::array<int, N> bits_;
+  //! The number of codes needed to cover all the tiles.
+  int code_count_;
+  //! True if the codes are Morton codes; false if they enumerate the tiles in row-major order.
+  bool morton_;
+
+  tiled_range(std::array<int, N> size, std::array<int, N> tile) : size_(size), tile_(tile) {
+    int64_t tile_count = 1;
+    int total_bits = 0;
+    for (std::size_t d = 0; d < N; d++) {
+      if (size[d] < 0)
+        throw std::invalid_argument("negative size of the index box");
+      if (tile[d] <= 0)
+        throw std::invalid_argument("tile sizes must be positive");
+      tiles_[d] = int((int64_t(size[d]) + tile[d] - 1) / tile[d]);
+      tile_count *= tiles_[d];
+      if (tile_count > std::numeric_limits<int>::max())
+        throw std::length_error("too many tiles in the index box");
+      bits_[d] = 0;
+      while ((int64_t(1) << bits_[d]) < tiles_[d])
+        bits_[d]++;
+      total_bits += bits_[d];
+    }
+    // An empty box has no tiles, and thus no codes.
+    morton_ = tile_count > 0 && total_bits < 31 &&
+              (int64_t(1) << total_bits) <= max_padding * tile_count;
+    code_count_ = morton_ ? 1 << total_bits : int(tile_count);
+  }
+
+  //! Returns the number of codes needed to cover all the tiles.
+  int code_count() const noexcept { return code_count_; }
+
+  //! Decodes `code` into tile coordinates. For Morton codes, bits are distributed round-robin
+  //! between the dimensions that still have bits left.
+  std::array<int, N> decode(uint32_t code) const noexcept {
+    std::array<int, N> coord{};
+    if (!morton_) {
+      for (std::size_t d = 0; d < N; d++) {
+        coord[d] = int(code % uint32_t(tiles_[d]));
+        code /= uint32_t(tiles_[d]);
+      }
+      return coord;
+    }
+    for (int level = 0; code != 0; level++) {
+      for (std::size_t d = 0; d < N; d++) {
+        if (level < bits_[d]) {
+          coord[d] |= int((code & 1) << level);
+          code >>= 1;
+        }
+      }
+    }
+    return coord;
+  }
+
+  //! Calls `f(begin, end)` for each valid tile with codes in range [`code_begin`, `code_end`).
+  template <typename Fn> void for_each_tile(uint32_t code_begin, uint32_t code_end, Fn& f) const {
+    for (uint32_t code = code_begin; code < code_end; code++) {
+      auto coord = decode(code);
+      std::array<int, N> begin;
+      std::array<int, N> end;
+      bool valid = true;
+      for (std::size_t d = 0; d < N && valid; d++) {
+        valid = coord[d] < tiles_[d];
+        begin[d] = valid ? coord[d] * tile_[d] : 0;
+        end[d] = int(std::min(int64_t(begin[d]) + tile_[d], int64_t(size_[d])));
+      }
+      if (valid)
+        std::invoke(f, begin, end);
+    }
+  }
+};
+
+//! Function called by the chunked bulk spawn that executes the tiles for a range of codes.
+template <std::size_t N, typename Fn> struct tiled_function {
+  //! The mapping between codes and tiles.
+  tiled_range<N> range_;
+  //! The user function, called for each tile.
+  Fn f_;
+
+  void operator()(uint64_t code_begin, uint64_t code_end) {
+    range_.for_each_tile(uint32_t(code_begin), uint32_t(code_end), f_);
+  }
+};
+
+} // namespace concore2full::detail
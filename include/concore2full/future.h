@@ -9,6 +9,9 @@ namespace concore2full {
 namespace detail {
 //! Tag type to indicate that a spawn operation is starting.
 struct start_spawn_t {};
+
+//! Spawns `fn` to be executed after the computation of `future` completes; see `future::then()`.
+template <typename Future, typename Fn> auto spawn_then(Future& future, Fn&& fn);
 } // namespace detail
 
 //! An asynchronous computation created from a `spawn`-like call.
@@ -40,6 +43,41 @@ public:
    */
   result_t await() { return frame_.await(); }
 
+  /**
+   * @brief Same as `await()`, but the stack of the awaiting coroutine may be parked while waiting.
+   * @return The result of the computation; throws if the operation was cancelled.
+   *
+   * If the awaiting coroutine runs on a stack from `stack::copying_stack_allocator`, and needs to
+   * wait for the computation, the used part of its stack is copied out and its memory is given
+   * back to the OS until the computation completes. The caller must ensure that, while waiting,
+   * nothing accesses the objects on the stack of the awaiting coroutine; in particular, the spawned
+   * computation must not refer to local variables of the caller (e.g., captured by reference).
+   * Otherwise, the accesses see zero-filled memory, and the writes are lost.
+   *
+   * Available only for futures created by `spawn`-like calls for a single computation (not for
+   * `copyable_spawn` or bulk spawns).
+   */
+  result_t await_parked() { return frame_.await_parked(); }
+
+  /**
+   * @brief Attach a continuation to be executed after the computation completes.
+   * @param fn The continuation; called with the result of the computation (if not `void`).
+   * @return A future for the result of `fn`; this object can be copied and moved.
+   *
+   * Available only for futures created by `escaping_spawn` and `copyable_spawn`. The continuation
+   * is spawned by the thread that completes the computation; no thread needs to wait in `await()`
+   * for the computation to complete.
+   *
+   * The continuation awaits this future (a copy of it); for `escaping_spawn` futures, the caller
+   * must not call `await()` on this object anymore.
+   */
+  template <typename Fn> auto then(Fn&& fn) {
+    return detail::spawn_then(*this, std::forward<Fn>(fn));
+  }
+
+  //! Returns the frame holder for this future; used to implement operations over futures.
+  FrameHolder& frame_holder() noexcept { return frame_; }
+
 private:
   //! The frame holding the state of the spawned computation.
   FrameHolder frame_;
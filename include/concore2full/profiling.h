@@ -3,9 +3,36 @@
 #include <string_view>
 #include <thread>
 
+// The instrumentation levels; see `CONCORE2FULL_INSTRUMENTATION_LEVEL`.
+#define CONCORE2FULL_INSTRUMENTATION_OFF 0
+#define CONCORE2FULL_INSTRUMENTATION_COUNTERS 1
+#define CONCORE2FULL_INSTRUMENTATION_ZONES 2
+#define CONCORE2FULL_INSTRUMENTATION_FULL 3
+
+// How much of the library is instrumented for profiling:
+//  - off: nothing; all the instrumentation is compiled out;
+//  - counters: only the counter tracks (e.g., the number of tasks in a thread pool);
+//  - zones: the counters, plus zones for the operations of the library, and named thread stacks;
+//  - full: the zones, plus named coroutine stacks, and tracing of the instrumented atomics.
+// The levels above off need a profiling backend; by default, we use the full level if there is a
+// backend, and off otherwise.
+#ifndef CONCORE2FULL_INSTRUMENTATION_LEVEL
 #if USE_PROFILING_LITE
+#define CONCORE2FULL_INSTRUMENTATION_LEVEL CONCORE2FULL_INSTRUMENTATION_FULL
+#else
+#define CONCORE2FULL_INSTRUMENTATION_LEVEL CONCORE2FULL_INSTRUMENTATION_OFF
+#endif
+#endif
 
+#if CONCORE2FULL_INSTRUMENTATION_LEVEL > CONCORE2FULL_INSTRUMENTATION_OFF && !USE_PROFILING_LITE
+#error "CONCORE2FULL_INSTRUMENTATION_LEVEL above off requires a profiling backend"
+#endif
+
+#if USE_PROFILING_LITE
 #include "profiling-lite.hpp"
+#endif
+
+#if CONCORE2FULL_INSTRUMENTATION_LEVEL >= CONCORE2FULL_INSTRUMENTATION_ZONES
 
 #define CURRENT_LOCATION() PROFILING_LITE_CURRENT_LOCATION()
 #define CURRENT_LOCATION_N(name) PROFILING_LITE_CURRENT_LOCATION_N(name)
@@ -14,8 +41,12 @@
   (void)profiling::zone_instant{CURRENT_LOCATION_N(#operation)};                                   \
   operation
 
+#if CONCORE2FULL_INSTRUMENTATION_LEVEL >= CONCORE2FULL_INSTRUMENTATION_FULL
 #define CONCORE2FULL_TRACE(static_name, value)                                                     \
   concore2full::profiling::trace(CURRENT_LOCATION_N("trace" #static_name), static_name, value)
+#else
+#define CONCORE2FULL_TRACE(static_name, value) 0
+#endif
 
 namespace concore2full::profiling {
 
@@ -80,18 +111,6 @@ inline void emit_thread_name_and_stack(const char* name) {
   profiling_lite::set_thread_name(profiling_lite::get_current_thread(), name);
 }
 
-namespace low_level {
-inline void define_counter_track(uint64_t tid, const char* name) {
-  profiling_lite::define_counter_track(tid, name);
-}
-inline void emit_counter_value(uint64_t tid, int64_t value) {
-  profiling_lite::emit_counter_value(tid, profiling_lite::now(), value);
-}
-inline void emit_counter_value(uint64_t tid, double value) {
-  profiling_lite::emit_counter_value(tid, profiling_lite::now(), value);
-}
-} // namespace low_level
-
 } // namespace concore2full::profiling
 
 #else
@@ -141,12 +160,6 @@ struct zone_instant {
   void set_category(const char* static_name) {}
 };
 
-namespace low_level {
-inline void define_counter_track(uint64_t tid, const char* name) {}
-inline void emit_counter_value(uint64_t tid, int64_t value) {}
-inline void emit_counter_value(uint64_t tid, double value) {}
-} // namespace low_level
-
 inline void define_stack(const void* begin, const void* end, const char* name) {}
 inline void emit_thread_name_and_stack(const char* name) {}
 
@@ -156,6 +169,24 @@ inline void emit_thread_name_and_stack(const char* name) {}
 
 namespace concore2full::profiling {
 
+namespace low_level {
+#if CONCORE2FULL_INSTRUMENTATION_LEVEL >= CONCORE2FULL_INSTRUMENTATION_COUNTERS
+inline void define_counter_track(uint64_t tid, const char* name) {
+  profiling_lite::define_counter_track(tid, name);
+}
+inline void emit_counter_value(uint64_t tid, int64_t value) {
+  profiling_lite::emit_counter_value(tid, profiling_lite::now(), value);
+}
+inline void emit_counter_value(uint64_t tid, double value) {
+  profiling_lite::emit_counter_value(tid, profiling_lite::now(), value);
+}
+#else
+inline void define_counter_track(uint64_t tid, const char* name) {}
+inline void emit_counter_value(uint64_t tid, int64_t value) {}
+inline void emit_counter_value(uint64_t tid, double value) {}
+#endif
+} // namespace low_level
+
 template <std::integral T>
 inline void define_counter_track(std::atomic<T>& counter, const char* name) {
   auto tid = reinterpret_cast<uint64_t>(&counter);
@@ -20,7 +20,7 @@ template <std::integral T> struct atomic : detail::catomic<T> {
 
   //! Gives a name to this atomic variable, for profiling purposes, creating a counter track for it.
   void set_name(const char* name) {
-#if USE_PROFILING_LITE
+#if CONCORE2FULL_INSTRUMENTATION_LEVEL >= CONCORE2FULL_INSTRUMENTATION_COUNTERS
     char buf[64];
     snprintf(buf, sizeof(buf), "%s_%p", name, this);
     auto tid = reinterpret_cast<uint64_t>(this);
@@ -270,7 +270,7 @@ template <std::integral T> struct atomic : detail::catomic<T> {
   T operator^=(T v) noexcept { return fetch_xor(v) ^ v; }
 
 private:
-#if USE_PROFILING_LITE
+#if CONCORE2FULL_INSTRUMENTATION_LEVEL >= CONCORE2FULL_INSTRUMENTATION_FULL
   using timestamp_t = profiling_lite::timestamp_t;
   static timestamp_t now() { return profiling_lite::now(); }
 #else
@@ -279,7 +279,7 @@ private:
 #endif
 
   void do_trace(timestamp_t t0, std::string_view name, T value) const {
-#if USE_PROFILING_LITE
+#if CONCORE2FULL_INSTRUMENTATION_LEVEL >= CONCORE2FULL_INSTRUMENTATION_FULL
     auto t1 = profiling_lite::now();
     void* stack_ptr = &t1;
     profiling_lite::emit_zone_start(stack_ptr, profiling_lite::get_current_thread(), t0,
@@ -298,7 +298,7 @@ private:
 #endif
   }
   void do_trace(timestamp_t t0, std::string_view name) const {
-#if USE_PROFILING_LITE
+#if CONCORE2FULL_INSTRUMENTATION_LEVEL >= CONCORE2FULL_INSTRUMENTATION_FULL
     do_trace(t0, name, base_t::load(std::memory_order_relaxed));
 #else
     (void)t0;
@@ -1,15 +1,30 @@
 #pragma once
 
+#include "concore2full/affinity_partitioner.h"
 #include "concore2full/c/spawn.h"
+#include "concore2full/current_thread_pool.h"
+#include "concore2full/detail/bulk_iterate_frame.h"
+#include "concore2full/detail/bulk_reduce_frame.h"
 #include "concore2full/detail/bulk_spawn_frame_full.h"
+#include "concore2full/detail/bulk_until_frame.h"
+#include "concore2full/detail/frame_with_options.h"
 #include "concore2full/detail/copyable_spawn_frame_base.h"
 #include "concore2full/detail/frame_with_value.h"
 #include "concore2full/detail/shared_frame.h"
 #include "concore2full/detail/spawn_frame_base.h"
+#include "concore2full/detail/then_frame.h"
+#include "concore2full/detail/tiled_range.h"
 #include "concore2full/detail/unique_frame.h"
 #include "concore2full/future.h"
+#include "concore2full/stop_token.h"
+#include "concore2full/thread_pool.h"
 
+#include <array>
 #include <concepts>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <type_traits>
 #include <utility>
 
 namespace concore2full {
@@ -20,7 +35,8 @@ namespace concore2full {
  * @param f The function representing the work that needs to be executed asynchronously.
  * @return A `spawn_future` object; this object cannot be copied or moved
  *
- * This will use the default scheduler to spawn new work concurrently.
+ * This will use the current thread pool (see `current_thread_pool()`) to spawn new work
+ * concurrently.
  *
  * The returned state object needs to stay alive for the entire duration of the computation.
  */
@@ -45,6 +61,107 @@ template <std::invocable Fn> inline auto copyable_spawn(Fn&& f) {
   return future<frame_holder_t>{detail::start_spawn_t{}, std::forward<Fn>(f)};
 }
 
+/**
+ * @brief Spawn work with the default scheduler, allowing it to be cancelled.
+ * @tparam Fn The type of the function to execute.
+ * @param token Token used to check whether the work needs to be cancelled.
+ * @param f The function representing the work that needs to be executed asynchronously.
+ * @return A `spawn_future` object; this object cannot be copied or moved
+ *
+ * If a stop is requested on `token` before `f` starts executing, `f` is not executed, and awaiting
+ * the returned future throws `operation_cancelled`. Queued work is dropped without creating a
+ * stack for it. Once started, `f` can check `token` to cooperatively stop early.
+ */
+template <std::invocable Fn> inline auto spawn(stop_token token, Fn&& f) {
+  using frame_holder_t = detail::frame_with_options<Fn>;
+  return future<frame_holder_t>{detail::start_spawn_t{}, current_thread_pool(), token,
+                                std::forward<Fn>(f)};
+}
+
+//! Same as `spawn(token, f)`, but the returned future can be copied and moved.
+//! The caller is responsible for calling `await` exactly once on the returned object.
+template <std::invocable Fn> inline auto escaping_spawn(stop_token token, Fn&& f) {
+  using frame_holder_t = detail::shared_frame<detail::frame_with_options<Fn>>;
+  return future<frame_holder_t>{detail::start_spawn_t{}, current_thread_pool(), token,
+                                std::forward<Fn>(f)};
+}
+
+/**
+ * @brief Spawn work with the default scheduler, obtaining the stack for it from `stacks`.
+ * @tparam Fn The type of the function to execute.
+ * @param stacks The resource used to obtain the stacks for the work, instead of the resource of
+ *               the thread pool (see `thread_pool::stack_resource()`).
+ * @param f The function representing the work that needs to be executed asynchronously.
+ * @return A `spawn_future` object; this object cannot be copied or moved
+ *
+ * `stacks` needs to outlive the returned object.
+ */
+template <std::invocable Fn>
+inline auto spawn(std::allocator_arg_t, stack::stack_resource& stacks, Fn&& f) {
+  using frame_holder_t = detail::frame_with_options<Fn>;
+  return future<frame_holder_t>{detail::start_spawn_t{}, current_thread_pool(), stop_token{},
+                                std::forward<Fn>(f), &stacks};
+}
+
+//! Same as `spawn(std::allocator_arg, stacks, f)`, but the returned future can be copied and
+//! moved. The caller is responsible for calling `await` exactly once on the returned object.
+template <std::invocable Fn>
+inline auto escaping_spawn(std::allocator_arg_t, stack::stack_resource& stacks, Fn&& f) {
+  using frame_holder_t = detail::shared_frame<detail::frame_with_options<Fn>>;
+  return future<frame_holder_t>{detail::start_spawn_t{}, current_thread_pool(), stop_token{},
+                                std::forward<Fn>(f), &stacks};
+}
+
+/**
+ * @brief Spawn work with the default scheduler, using a stack of the given size class.
+ * @tparam Fn The type of the function to execute.
+ * @param size_class Hint for the stack size needed by `f`; e.g., `stack_size_class::small` for
+ *                   leaf work that doesn't go deep into the stack.
+ * @param f The function representing the work that needs to be executed asynchronously.
+ * @return A `spawn_future` object; this object cannot be copied or moved
+ *
+ * The stack is obtained from the resource of the current thread pool; the default resource (see
+ * `stack::default_stack_resource()`) keeps a separate pool of stacks for each size class.
+ */
+template <std::invocable Fn> inline auto spawn(stack::stack_size_class size_class, Fn&& f) {
+  using frame_holder_t = detail::frame_with_options<Fn>;
+  return future<frame_holder_t>{detail::start_spawn_t{}, current_thread_pool(), stop_token{},
+                                std::forward<Fn>(f), nullptr, size_class};
+}
+
+//! Same as `spawn(size_class, f)`, but the returned future can be copied and moved.
+//! The caller is responsible for calling `await` exactly once on the returned object.
+template <std::invocable Fn>
+inline auto escaping_spawn(stack::stack_size_class size_class, Fn&& f) {
+  using frame_holder_t = detail::shared_frame<detail::frame_with_options<Fn>>;
+  return future<frame_holder_t>{detail::start_spawn_t{}, current_thread_pool(), stop_token{},
+                                std::forward<Fn>(f), nullptr, size_class};
+}
+
+/**
+ * @brief Spawn work on the given thread pool.
+ * @tparam Fn The type of the function to execute.
+ * @param pool The thread pool on which the work is executed.
+ * @param f The function representing the work that needs to be executed asynchronously.
+ * @return A `spawn_future` object; this object cannot be copied or moved
+ *
+ * The thread that awaits the returned future may continue on a thread of `pool`. The work spawned
+ * from within `f` goes to `pool`, unless specified otherwise.
+ *
+ * `pool` needs to outlive the returned object.
+ */
+template <std::invocable Fn> inline auto spawn_on(thread_pool& pool, Fn&& f) {
+  using frame_holder_t = detail::frame_with_options<Fn>;
+  return future<frame_holder_t>{detail::start_spawn_t{}, pool, stop_token{}, std::forward<Fn>(f)};
+}
+
+//! Same as `spawn_on(pool, f)`, but the work is dropped if a stop is requested on `token` before
+//! `f` starts executing; see `spawn(token, f)`.
+template <std::invocable Fn> inline auto spawn_on(thread_pool& pool, stop_token token, Fn&& f) {
+  using frame_holder_t = detail::frame_with_options<Fn>;
+  return future<frame_holder_t>{detail::start_spawn_t{}, pool, token, std::forward<Fn>(f)};
+}
+
 /**
  * @brief Bulk spawn work with the default scheduler.
  * @tparam Fn The type of the function to execute.
@@ -52,15 +169,269 @@ template <std::invocable Fn> inline auto copyable_spawn(Fn&& f) {
  * @param f The function representing the work that needs to be executed asynchronously.
  * @return A `bulk_spawn_future` object; this object cannot be copied or moved
  *
- * This will use the default scheduler to spawn new work concurrently.
+ * This will use the current thread pool (see `current_thread_pool()`) to spawn new work
+ * concurrently.
  *
  * The returned state object needs to stay alive for the entire duration of the computation.
  */
-template <typename Fn> inline auto bulk_spawn(int count, Fn&& f) {
+template <typename Fn> inline auto bulk_spawn(int64_t count, Fn&& f) {
+  return bulk_spawn_on(current_thread_pool(), count, std::forward<Fn>(f));
+}
+
+//! Same as `bulk_spawn(count, f)`, but the work is spawned on `pool`.
+//! `pool` needs to outlive the returned object.
+template <typename Fn> inline auto bulk_spawn_on(thread_pool& pool, int64_t count, Fn&& f) {
   assert(count > 0);
   using frame_holder_t = detail::unique_frame<detail::bulk_spawn_frame_full<Fn>>;
-  auto uptr = detail::bulk_spawn_frame_full<Fn>::allocate(count, std::forward<Fn>(f));
+  auto uptr = detail::bulk_spawn_frame_full<Fn>::allocate(pool, count, std::forward<Fn>(f));
+  return future<frame_holder_t>{detail::start_spawn_t{}, std::move(uptr)};
+}
+
+//! Same as `bulk_spawn(count, f)`, but tries to execute the indices on the same workers that
+//! executed them in the previous bulk spawn with `partitioner`; see `affinity_partitioner`.
+//! `partitioner` needs to outlive the returned object.
+template <typename Fn>
+inline auto bulk_spawn(int64_t count, Fn&& f, affinity_partitioner& partitioner) {
+  return bulk_spawn_on(current_thread_pool(), count, std::forward<Fn>(f), partitioner);
+}
+
+//! Same as `bulk_spawn(count, f, partitioner)`, but the work is spawned on `pool`.
+//! `pool` and `partitioner` need to outlive the returned object.
+template <typename Fn>
+inline auto bulk_spawn_on(thread_pool& pool, int64_t count, Fn&& f,
+                          affinity_partitioner& partitioner) {
+  assert(count > 0);
+  using frame_t = detail::bulk_spawn_frame_full<Fn>;
+  using frame_holder_t = detail::unique_frame<frame_t>;
+  auto uptr = frame_t::allocate(pool, count, std::forward<Fn>(f), 0, &partitioner);
+  return future<frame_holder_t>{detail::start_spawn_t{}, std::move(uptr)};
+}
+
+//! Same as `bulk_spawn(count, f)`, but the stacks for the threads of execution are obtained from
+//! `stacks`, instead of the resource of the thread pool. `stacks` needs to outlive the returned
+//! object.
+template <typename Fn>
+inline auto bulk_spawn(std::allocator_arg_t, stack::stack_resource& stacks, int64_t count,
+                       Fn&& f) {
+  assert(count > 0);
+  using frame_t = detail::bulk_spawn_frame_full<Fn>;
+  using frame_holder_t = detail::unique_frame<frame_t>;
+  auto uptr =
+      frame_t::allocate(current_thread_pool(), count, std::forward<Fn>(f), 0, nullptr, &stacks);
+  return future<frame_holder_t>{detail::start_spawn_t{}, std::move(uptr)};
+}
+
+//! Same as `bulk_spawn(count, f)`, but the threads of execution use stacks of `size_class`; see
+//! `spawn(size_class, f)`.
+template <typename Fn>
+inline auto bulk_spawn(stack::stack_size_class size_class, int64_t count, Fn&& f) {
+  assert(count > 0);
+  using frame_t = detail::bulk_spawn_frame_full<Fn>;
+  using frame_holder_t = detail::unique_frame<frame_t>;
+  auto uptr = frame_t::allocate(current_thread_pool(), count, std::forward<Fn>(f), 0, nullptr,
+                                nullptr, size_class);
+  return future<frame_holder_t>{detail::start_spawn_t{}, std::move(uptr)};
+}
+
+/**
+ * @brief Bulk spawn work that is executed in chunks of indices.
+ * @tparam Fn The type of the function to execute.
+ * @param count The number of indices to execute.
+ * @param grain The number of indices in a chunk; if zero, it is chosen automatically.
+ * @param f The function executing a chunk of indices, called as `f(begin, end)`.
+ * @return A `bulk_spawn_future` object; this object cannot be copied or moved
+ *
+ * Unlike `bulk_spawn`, which calls `f` for each index, this calls `f` for ranges [begin, end) of
+ * indices; this allows the compiler to vectorize the body over the indices of a chunk, and reduces
+ * the per-index overhead for cheap bodies. All chunks start at multiples of `grain` and contain
+ * `grain` indices, except for the last one.
+ *
+ * If `grain` is zero, the size of the chunks is adjusted while executing, based on the time needed
+ * to execute the previous chunks.
+ *
+ * The returned state object needs to stay alive for the entire duration of the computation.
+ */
+template <typename Fn> inline auto bulk_spawn_chunked(int64_t count, int64_t grain, Fn&& f) {
+  return bulk_spawn_chunked_on(current_thread_pool(), count, grain, std::forward<Fn>(f));
+}
+
+//! Same as `bulk_spawn_chunked(count, grain, f)`, with the grain chosen automatically.
+template <typename Fn> inline auto bulk_spawn_chunked(int64_t count, Fn&& f) {
+  return bulk_spawn_chunked_on(current_thread_pool(), count, 0, std::forward<Fn>(f));
+}
+
+//! Same as `bulk_spawn_chunked(count, grain, f)`, but the work is spawned on `pool`.
+//! `pool` needs to outlive the returned object.
+template <typename Fn>
+inline auto bulk_spawn_chunked_on(thread_pool& pool, int64_t count, int64_t grain, Fn&& f) {
+  assert(count > 0);
+  assert(grain >= 0);
+  using frame_t = detail::bulk_spawn_frame_full<Fn, true>;
+  using frame_holder_t = detail::unique_frame<frame_t>;
+  auto uptr = frame_t::allocate(pool, count, std::forward<Fn>(f), grain);
   return future<frame_holder_t>{detail::start_spawn_t{}, std::move(uptr)};
 }
 
-} // namespace concore2full
\ No newline at end of file
+/**
+ * @brief Bulk spawn work that is executed for a number of iterations, as supersteps.
+ * @tparam Fn The type of the function to execute.
+ * @param count The number of indices to execute in each iteration.
+ * @param iterations The number of iterations.
+ * @param f The function executing one step, called as `f(iteration, index)`.
+ * @return A `bulk_spawn_future` object; this object cannot be copied or moved
+ *
+ * This is equivalent to calling `bulk_spawn(count, ...).await()` in a loop, but the threads of
+ * execution (and their stacks) are created only once, and kept alive for all the iterations. All
+ * the steps of one iteration are completed before any step of the next iteration starts; the
+ * threads of execution that finish early wait at a barrier for the others.
+ *
+ * The returned state object needs to stay alive for the entire duration of the computation.
+ */
+template <typename Fn> inline auto bulk_iterate(int64_t count, int64_t iterations, Fn&& f) {
+  return bulk_iterate_on(current_thread_pool(), count, iterations, std::forward<Fn>(f));
+}
+
+//! Same as `bulk_iterate(count, iterations, f)`, but the work is spawned on `pool`.
+//! `pool` needs to outlive the returned object.
+template <typename Fn>
+inline auto bulk_iterate_on(thread_pool& pool, int64_t count, int64_t iterations, Fn&& f) {
+  assert(count > 0);
+  assert(iterations > 0);
+  using frame_t = detail::bulk_iterate_frame<Fn>;
+  using frame_holder_t = detail::unique_frame<frame_t>;
+  auto uptr = frame_t::allocate(pool, count, iterations, std::forward<Fn>(f));
+  return future<frame_holder_t>{detail::start_spawn_t{}, std::move(uptr)};
+}
+
+/**
+ * @brief Concurrently reduces the values obtained for indices in range [0, `count`).
+ * @tparam T The type of the result.
+ * @param count The number of indices to reduce.
+ * @param identity The identity value for `combine`.
+ * @param map The function that maps an index to a value, called as `map(index)`.
+ * @param combine The function that combines two values, called as `combine(a, b)`.
+ * @return A future for the combined value; this object cannot be copied or moved
+ *
+ * `combine` needs to be associative and commutative; the values may be combined in any order.
+ *
+ * Each thread of execution accumulates values into its own partial result, kept in the bulk frame;
+ * the partial results are combined as the threads of execution finish. There is no need for the
+ * user to allocate storage for intermediate values, and no serial combining step after the
+ * computation.
+ *
+ * The returned state object needs to stay alive for the entire duration of the computation.
+ */
+template <typename T, typename Map, typename Combine>
+inline auto bulk_reduce(int64_t count, T identity, Map&& map, Combine&& combine) {
+  return bulk_reduce_on(current_thread_pool(), count, std::move(identity), std::forward<Map>(map),
+                        std::forward<Combine>(combine));
+}
+
+//! Same as `bulk_reduce(count, identity, map, combine)`, but the work is spawned on `pool`.
+//! `pool` needs to outlive the returned object.
+template <typename T, typename Map, typename Combine>
+inline auto bulk_reduce_on(thread_pool& pool, int64_t count, T identity, Map&& map,
+                           Combine&& combine) {
+  assert(count > 0);
+  using frame_t = detail::bulk_reduce_frame<T, std::decay_t<Map>, std::decay_t<Combine>>;
+  using frame_holder_t = detail::unique_frame<frame_t>;
+  auto uptr = frame_t::allocate(pool, count, std::move(identity), std::forward<Map>(map),
+                                std::forward<Combine>(combine));
+  return future<frame_holder_t>{detail::start_spawn_t{}, std::move(uptr)};
+}
+
+/**
+ * @brief Bulk spawn work that can stop early, once a result is found.
+ * @tparam Fn The type of the function to execute.
+ * @param count The number of indices to execute.
+ * @param f The function to execute for each index, called as `f(index)`; returns true to signal
+ *          that the indices greater than `index` don't need to be executed.
+ * @return A future for the smallest index for which `f` returned true, or `count` if `f` returned
+ *         false for all indices; this object cannot be copied or moved
+ *
+ * Once `f` returns true for an index, the indices greater than it that are not yet started are
+ * skipped, without calling `f` for them; the indices smaller than it are still executed. Awaiting
+ * the result only waits for the calls to `f` that are already running.
+ *
+ * The returned state object needs to stay alive for the entire duration of the computation.
+ */
+template <typename Fn> inline auto bulk_spawn_until(int64_t count, Fn&& f) {
+  return bulk_spawn_until_on(current_thread_pool(), count, std::forward<Fn>(f));
+}
+
+//! Same as `bulk_spawn_until(count, f)`, but the work is spawned on `pool`.
+//! `pool` needs to outlive the returned object.
+template <typename Fn> inline auto bulk_spawn_until_on(thread_pool& pool, int64_t count, Fn&& f) {
+  assert(count > 0);
+  using frame_t = detail::bulk_until_frame<Fn>;
+  using frame_holder_t = detail::unique_frame<frame_t>;
+  auto uptr = frame_t::allocate(pool, count, std::forward<Fn>(f));
+  return future<frame_holder_t>{detail::start_spawn_t{}, std::move(uptr)};
+}
+
+//! Concurrently finds the first element in range [`first`, `last`) for which `pred` returns true;
+//! returns `last` if there is no such element. Elements after a found one are not checked.
+template <std::random_access_iterator It, typename Pred>
+inline It parallel_find_if(It first, It last, Pred pred) {
+  if (first == last)
+    return last;
+  int64_t count = int64_t(last - first);
+  auto matches = [first, &pred](int64_t i) -> bool { return std::invoke(pred, first[i]); };
+  return first + bulk_spawn_until(count, matches).await();
+}
+
+/**
+ * @brief Bulk spawn work over a 2D index box, split into tiles.
+ * @tparam Fn The type of the function to execute.
+ * @param size The size of the index box, on each dimension.
+ * @param tile The size of a tile, on each dimension.
+ * @param f The function executing a tile, called as `f(begin, end)`, with `std::array<int, 2>`
+ *          coordinates; the tile covers indices from `begin` (inclusive) to `end` (exclusive).
+ * @return A `bulk_spawn_future` object; this object cannot be copied or moved
+ *
+ * The tiles are traversed in Morton order, and each worker executes contiguous ranges of tiles in
+ * this order; thus, neighbouring tiles tend to be executed by the same worker, improving cache
+ * locality. Load balancing happens at tile granularity. If the Morton order would need too many
+ * codes that don't correspond to tiles (e.g., when the number of tiles on a dimension is just over
+ * a power of two), the tiles are traversed in row-major order instead.
+ *
+ * If `size` is zero in any dimension, `f` is never called. Throws `std::invalid_argument` if a
+ * size is negative or a tile size is not positive, and `std::length_error` if the number of tiles
+ * doesn't fit in an `int`.
+ *
+ * The returned state object needs to stay alive for the entire duration of the computation.
+ */
+template <typename Fn>
+inline auto bulk_spawn_2d(std::array<int, 2> size, std::array<int, 2> tile, Fn&& f) {
+  return bulk_spawn_tiled_on(current_thread_pool(), size, tile, std::forward<Fn>(f));
+}
+
+//! Same as `bulk_spawn_2d`, but for a 3D index box; `f` is called with `std::array<int, 3>`
+//! coordinates.
+template <typename Fn>
+inline auto bulk_spawn_3d(std::array<int, 3> size, std::array<int, 3> tile, Fn&& f) {
+  return bulk_spawn_tiled_on(current_thread_pool(), size, tile, std::forward<Fn>(f));
+}
+
+//! Same as `bulk_spawn_2d` or `bulk_spawn_3d`, but the work is spawned on `pool`.
+//! `pool` needs to outlive the returned object.
+template <std::size_t N, typename Fn>
+inline auto bulk_spawn_tiled_on(thread_pool& pool, std::array<int, N> size,
+                                std::array<int, N> tile, Fn&& f) {
+  detail::tiled_range<N> range{size, tile};
+  int count = range.code_count();
+  // Let the chunking logic group the cheap tiles together.
+  return bulk_spawn_chunked_on(pool, count, 0,
+                               detail::tiled_function<N, Fn>{range, std::forward<Fn>(f)});
+}
+
+namespace detail {
+template <typename Future, typename Fn> inline auto spawn_then(Future& future, Fn&& fn) {
+  static_assert(std::is_copy_constructible_v<Future>,
+                "`then` can only be called on futures from `escaping_spawn` or `copyable_spawn`");
+  using frame_holder_t = shared_frame<then_frame<Future, std::decay_t<Fn>>>;
+  return concore2full::future<frame_holder_t>{start_spawn_t{}, future, std::forward<Fn>(fn)};
+}
+} // namespace detail
+
+} // namespace concore2full
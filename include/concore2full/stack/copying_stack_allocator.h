@@ -0,0 +1,77 @@
+#pragma once
+
+#include "concore2full/stack/stack_allocator.h"
+
+#include <cstdint>
+
+namespace concore2full {
+namespace stack {
+
+/// @brief A stack allocator whose coroutines release their stack memory while they are parked.
+///
+/// The stacks are carved out of a large reserved address range, in fixed-size slots; the slot size
+/// is the requested size rounded up to a power of two. Because the stacks are at known addresses,
+/// the library can find the stack of a suspended coroutine from its continuation. The tops of the
+/// stacks are placed at different offsets (of at most 4 KB) from the ends of their slots, so that
+/// they don't map to the same cache sets; thus, the stacks are slightly smaller than the slots.
+///
+/// When a coroutine running on such a stack is parked in `future::await_parked()` (the awaited
+/// work is still running on another thread), the used part of the stack (from the saved context up
+/// to the top of the stack) is copied into a right-sized heap buffer, and the memory of the stack
+/// is given back to the OS. When the coroutine is resumed, the copy is restored at the same
+/// addresses, so the pointers into the stack remain valid. A parked coroutine thus holds a few KB
+/// of memory, instead of all the pages its stack has touched, allowing millions of parked
+/// coroutines.
+///
+/// Parking is an explicit opt-in, as the library cannot know whether other threads access objects
+/// on the stack while the coroutine waits (e.g., local variables captured by reference in the
+/// spawned work). A plain `await()`, and the await of bulk spawns, never park. The library also
+/// doesn't park a coroutine if the awaited frame is on its stack (e.g., for `spawn()`), so the
+/// stacks are only copied when awaiting heap-allocated frames, like the ones created by
+/// `escaping_spawn()`.
+///
+/// The slots don't have guard pages. Deallocated stacks are kept for reuse. The OS keeps the page
+/// tables for the slots that were used (about 2 KB for each 1 MB of slots); for millions of parked
+/// coroutines, prefer small stacks (e.g., 64 KB).
+class copying_stack_allocator {
+  std::size_t size_;
+
+public:
+  /// The default stack size
+  static constexpr std::size_t default_size_ = 1024 * 1024;
+
+  /// @brief Initializes the size to be used when allocating stacks.
+  /// @param size The size to be used for allocating stack. Default = 1MB
+  copying_stack_allocator(std::size_t size = default_size_) : size_(size) {}
+
+  /// @brief Allocate a stack to be used for coroutines.
+  /// @return Details about the allocated stack memory.
+  stack_t allocate();
+  /// @brief Deallocate the stack memory, keeping its slot for reuse.
+  /// @param stack Object indicating the stack that needs to be deallocated.
+  void deallocate(stack_t stack);
+
+  /// @brief The number of coroutines that are currently parked, with their stacks copied out.
+  static int64_t parked_count() noexcept;
+  /// @brief The number of bytes held by the copies of the parked stacks.
+  static int64_t parked_bytes() noexcept;
+};
+
+namespace detail {
+
+//! If `sp` is the saved context of a suspended coroutine with a stack obtained from
+//! `copying_stack_allocator`, copies the used part of the stack to the heap, and releases the
+//! memory of the stack. Does nothing if `shared` (an object accessed by other threads while the
+//! coroutine is suspended) is on the used part of the stack. Returns true if the stack was parked.
+//!
+//! The coroutine must not be resumed before calling `unpark_stack()`.
+bool park_stack(void* sp, const void* shared) noexcept;
+
+//! Restores the stack of a coroutine parked by `park_stack()`; does nothing if the coroutine with
+//! the saved context `sp` is not parked.
+void unpark_stack(void* sp) noexcept;
+
+} // namespace detail
+
+} // namespace stack
+} // namespace concore2full
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "concore2full/stack/stack_allocator.h"
+
+namespace concore2full {
+namespace stack {
+
+/// @brief A stack allocator that carves stacks out of arenas backed by huge pages.
+///
+/// The stacks are allocated from large arenas, aligned to 2 MB, that are mapped with explicit huge
+/// pages if the system has them reserved, or advised to use transparent huge pages otherwise. If
+/// neither is available, the arenas use normal pages. With many live coroutines, the stacks share
+/// a few large TLB entries instead of needing one entry per 4 KB page, reducing the TLB misses when
+/// switching between coroutines.
+///
+/// The stacks are never given back to the OS; deallocated stacks are kept in a global free list,
+/// for reuse. There are no guard pages between the stacks. Combine with pooling, as
+/// `basic_pooled_stack_allocator<huge_page_stack_allocator>`, to avoid the global lock on the
+/// common path.
+class huge_page_stack_allocator {
+  std::size_t size_;
+
+public:
+  /// The default stack size
+  static constexpr std::size_t default_size_ = 1024 * 1024;
+  /// The size of a huge page, and the alignment of the arenas.
+  static constexpr std::size_t huge_page_size_ = 2 * 1024 * 1024;
+
+  /// The kind of pages backing the arenas.
+  enum class page_kind {
+    normal,         //!< Normal pages; huge pages are not available.
+    transparent,    //!< Advised to use transparent huge pages.
+    explicit_huge,  //!< Explicit (reserved) huge pages.
+  };
+
+  /// @brief Initializes the size to be used when allocating stacks.
+  /// @param size The size to be used for allocating stack. Default = 1MB
+  huge_page_stack_allocator(std::size_t size = default_size_) : size_(size) {}
+
+  /// @brief Allocate a stack to be used for coroutines.
+  /// @return Details about the allocated stack memory.
+  stack_t allocate();
+  /// @brief Deallocate the stack memory, keeping it for later allocations.
+  /// @param stack Object indicating the stack that needs to be deallocated.
+  void deallocate(stack_t stack);
+
+  /// @brief Returns the kind of pages backing the most recently created arena.
+  static page_kind arena_page_kind() noexcept;
+};
+
+} // namespace stack
+} // namespace concore2full
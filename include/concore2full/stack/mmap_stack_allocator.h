@@ -0,0 +1,41 @@
+#pragma once
+
+#include "concore2full/stack/stack_allocator.h"
+
+namespace concore2full {
+namespace stack {
+
+/// @brief A stack allocator that maps the stacks directly from the OS, with guard pages.
+///
+/// Each stack is obtained with `mmap`, with one inaccessible page placed below it; a stack overflow
+/// touches the guard page and crashes the program, instead of silently corrupting other memory.
+/// The memory of the stack is only reserved; pages are committed by the OS, as the stack grows, on
+/// the first access. Thus, the resident memory of a coroutine matches its actual stack depth.
+///
+/// The stack size is rounded up to a multiple of the page size.
+///
+/// Can be combined with pooling, as `basic_pooled_stack_allocator<mmap_stack_allocator>`.
+class mmap_stack_allocator {
+  std::size_t size_;
+
+public:
+  /// The default stack size
+  static constexpr std::size_t default_size_ = 1024 * 1024;
+
+  /// @brief Initializes the size to be used when allocating stacks.
+  /// @param size The size to be used for allocating stack. Default = 1MB
+  mmap_stack_allocator(std::size_t size = default_size_) : size_(size) {}
+
+  /// @brief Allocate a stack to be used for coroutines.
+  /// @return Details about the newly allocated stack memory; the guard page is not included.
+  stack_t allocate();
+  /// @brief Deallocate the stack memory, including the guard page.
+  /// @param stack Object indicating the stack that needs to be deallocated.
+  void deallocate(stack_t stack);
+
+  /// @brief Returns the size of a memory page.
+  static std::size_t page_size() noexcept;
+};
+
+} // namespace stack
+} // namespace concore2full
@@ -0,0 +1,212 @@
+#pragma once
+
+#include "concore2full/stack/simple_stack_allocator.h"
+#include "concore2full/stack/stack_allocator.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+namespace concore2full {
+namespace stack {
+
+namespace detail {
+
+//! A free stack; stored in the stack memory itself, just below its top (which is likely to be
+//! resident, even if the rest of the stack is trimmed).
+struct free_stack {
+  free_stack* next_;
+  //! The time at which the stack became free, in nanoseconds of a coarse monotonic clock.
+  int64_t idle_since_;
+  //! True if the memory of the stack (except its top) was given back to the OS.
+  bool trimmed_;
+};
+
+//! A list of free stacks.
+struct free_stack_list {
+  free_stack* head_{nullptr};
+  int count_{0};
+
+  void push(free_stack* s) noexcept {
+    s->next_ = head_;
+    head_ = s;
+    count_++;
+  }
+  free_stack* pop() noexcept {
+    free_stack* s = head_;
+    head_ = s->next_;
+    count_--;
+    return s;
+  }
+  //! Moves at most `n` stacks from this list to `other`.
+  void move_to(free_stack_list& other, int n) noexcept {
+    for (int i = 0; i < n && head_; i++)
+      other.push(pop());
+  }
+};
+
+struct thread_stack_cache;
+
+/// @brief A pool of free stacks of the same size.
+///
+/// Each OS thread keeps a small cache of free stacks for each pool; the caches are refilled from,
+/// and overflow into, a global depot. The stacks that don't fit into the depot are released.
+///
+/// The free stacks can be *trimmed*: the memory below their top `trim_keep_size` bytes is given
+/// back to the OS, with `madvise(MADV_DONTNEED)`. The address range stays valid; the pages are
+/// committed again, zero-filled, when a coroutine touches them. The depot trims the stacks idle for
+/// more than `idle_trim_threshold` as the pool is used; `trim()` trims on demand. The stacks in
+/// the thread caches are only trimmed on demand, so the threads keep their hot stacks resident.
+///
+/// Only a limited number of pools have thread caches; if more pools are created, the extra ones
+/// keep their free stacks only in the depot.
+class stack_pool {
+public:
+  //! Type of the function that releases the memory of a stack.
+  using release_t = void (*)(stack_t);
+
+  //! Creates a pool for stacks of `stack_size` bytes, released with `release`.
+  stack_pool(std::size_t stack_size, release_t release) noexcept;
+
+  //! Takes a free stack from the pool; returns false if there is none.
+  bool try_take(stack_t& stack) noexcept;
+  //! Gives back a stack to the pool; the stack may be released if the pool is full.
+  void give_back(stack_t stack) noexcept;
+
+  //! Trims the free stacks that are idle for at least `min_idle`; returns the number of resident
+  //! bytes given back to the OS. The stacks cached by idle threads (see `begin_thread_idle()`) are
+  //! trimmed right away; the ones cached by other threads are trimmed the next time these threads
+  //! use the pool.
+  std::size_t trim(std::chrono::nanoseconds min_idle) noexcept;
+
+  //! The size of the stacks in this pool.
+  std::size_t stack_size() const noexcept { return stack_size_; }
+
+  //! The pool created before this one; null for the first pool.
+  stack_pool* next_pool_;
+
+private:
+  friend struct thread_stack_cache;
+
+  //! The index of the pool, used to find the thread cache for this pool.
+  int index_;
+  //! The size of the stacks in this pool.
+  std::size_t stack_size_;
+  //! The function used to release the memory of the stacks.
+  release_t release_;
+  //! Protects `depot_`.
+  std::mutex bottleneck_;
+  //! The free stacks that can be taken by any thread.
+  free_stack_list depot_;
+  //! The number of stacks in the depot, readable without taking the lock.
+  std::atomic<int> available_{0};
+  //! The last time the depot was checked for idle stacks; protected by `bottleneck_`.
+  int64_t last_idle_check_{0};
+  //! Incremented for each `trim()` request; the thread caches compare it with the last value seen.
+  std::atomic<uint32_t> trim_epoch_{0};
+  //! The minimum idle time for the stacks to be trimmed by the last `trim()` request.
+  std::atomic<int64_t> trim_min_idle_{0};
+
+  //! Moves at most `n` stacks from the depot to `to`.
+  void take_from_depot(free_stack_list& to, int n) noexcept;
+  //! Moves at most `n` stacks from `from` to the depot, as long as the depot is not full.
+  void give_to_depot(free_stack_list& from, int n) noexcept;
+  //! Releases all the stacks from `stacks`.
+  void release(free_stack_list& stacks) noexcept;
+  //! Trims the stacks from `stacks` that are idle for at least `min_idle` nanoseconds.
+  std::size_t trim(free_stack_list& stacks, int64_t min_idle, int64_t now) noexcept;
+  //! Trims the stacks of the cache of the current thread, if requested since the last check.
+  void trim_thread_cache_if_requested(thread_stack_cache& cache) noexcept;
+  //! Trims the stacks that the idle threads cache for this pool.
+  std::size_t trim_idle_thread_caches(int64_t min_idle, int64_t now) noexcept;
+};
+
+//! The top part of the free stacks that is kept when trimming.
+constexpr std::size_t trim_keep_size = 16 * 1024;
+//! The stacks from the depot that are idle for at least this long are trimmed automatically.
+constexpr std::chrono::nanoseconds idle_trim_threshold = std::chrono::seconds(1);
+
+//! Marks the current thread as idle: until `end_thread_idle()`, the trim requests from other
+//! threads also trim the stacks cached by this thread. The thread must not use the pools in
+//! between. Called right before the threads block, waiting to be woken up.
+void begin_thread_idle() noexcept;
+//! Marks the current thread as active again, after `begin_thread_idle()`; waits for the trimming
+//! of its caches, if in progress.
+void end_thread_idle() noexcept;
+
+} // namespace detail
+
+/// @brief A stack allocator that reuses the stacks of finished coroutines.
+/// @tparam Upstream The allocator used to obtain new stacks, and to release the unneeded ones.
+///
+/// Each OS thread keeps a small cache of free stacks; allocating and deallocating a stack from the
+/// cache doesn't require any synchronization, and the memory of the stack is likely to be already
+/// mapped and in the CPU caches. A stack can be deallocated on a different thread than the one that
+/// allocated it; when the cache of a thread overflows, a batch of stacks is moved to a global
+/// depot, from which the other threads can refill their caches. The depot is bounded; stacks that
+/// don't fit into it are given back to `Upstream`.
+///
+/// Only stacks of `PoolSize` bytes (by default, the default size of `Upstream`) are pooled; stacks
+/// of other sizes are allocated directly with `Upstream`. Allocators with different `PoolSize`
+/// values use different pools. Only the first 8 pools created in the program have thread caches;
+/// the other pools keep their free stacks only in the depot, taking a lock for each stack.
+template <stack_allocator Upstream, std::size_t PoolSize = Upstream::default_size_>
+class basic_pooled_stack_allocator {
+  std::size_t size_;
+
+public:
+  /// The default stack size
+  static constexpr std::size_t default_size_ = PoolSize;
+
+  /// @brief Initializes the size to be used when allocating stacks.
+  /// @param size The size to be used for allocating stack. Default = `PoolSize`
+  basic_pooled_stack_allocator(std::size_t size = default_size_) : size_(size) {}
+
+  /// @brief Allocate a stack to be used for coroutines.
+  /// @return Details about the allocated stack memory.
+  stack_t allocate() {
+    stack_t stack;
+    if (size_ == default_size_ && pool().try_take(stack))
+      return stack;
+    return Upstream{size_}.allocate();
+  }
+  /// @brief Deallocate the stack memory, keeping it for reuse, if possible.
+  /// @param stack Object indicating the stack that needs to be deallocated.
+  void deallocate(stack_t stack) {
+    if (stack.size == default_size_)
+      pool().give_back(stack);
+    else
+      Upstream{stack.size}.deallocate(stack);
+  }
+
+  /// @brief Gives back to the OS the memory of the free stacks idle for at least `min_idle`.
+  /// @return The number of resident bytes given back to the OS.
+  ///
+  /// Only the top part of the stacks is kept. The stacks cached by the threads that are blocked in
+  /// the library (e.g., the sleeping workers of thread pools) are trimmed right away; the ones
+  /// cached by other threads are trimmed the next time these threads use the allocator.
+  static std::size_t trim(std::chrono::nanoseconds min_idle = {}) { return pool().trim(min_idle); }
+
+private:
+  //! The pool of stacks for this upstream allocator; never destroyed, as threads may give back
+  //! their stacks after the static objects are destroyed.
+  static detail::stack_pool& pool() {
+    static detail::stack_pool* instance = new detail::stack_pool(
+        default_size_, [](stack_t stack) { Upstream{stack.size}.deallocate(stack); });
+    return *instance;
+  }
+};
+
+/// @brief The default pooled stack allocator, obtaining the stacks with `malloc`.
+using pooled_stack_allocator = basic_pooled_stack_allocator<simple_stack_allocator>;
+
+/// @brief Trims the free stacks of all the pooled stack allocators; e.g., on memory pressure.
+/// @param min_idle The minimum time the stacks need to be idle to be trimmed.
+/// @return The number of resident bytes given back to the OS.
+///
+/// See `basic_pooled_stack_allocator::trim()`.
+std::size_t trim_pooled_stacks(std::chrono::nanoseconds min_idle = {});
+
+} // namespace stack
+} // namespace concore2full
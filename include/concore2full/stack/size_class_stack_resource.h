@@ -0,0 +1,40 @@
+#pragma once
+
+#include "concore2full/stack/stack_resource.h"
+
+namespace concore2full {
+namespace stack {
+
+/// @brief A stack resource that serves each `stack_size_class` from its own pool.
+///
+/// Each size class has a fixed stack size; the stacks of each class are pooled separately (see
+/// `basic_pooled_stack_allocator`), so a small stack is never used for a coroutine asking for a
+/// larger one, and the small stacks are not wasted on coroutines that don't need them.
+class size_class_stack_resource : public stack_resource {
+public:
+  /// The size of the stacks of the `small` class.
+  static constexpr std::size_t small_size = 64 * 1024;
+  /// The size of the stacks of the `normal` class.
+  static constexpr std::size_t normal_size = 1024 * 1024;
+  /// The size of the stacks of the `large` class.
+  static constexpr std::size_t large_size = 8 * 1024 * 1024;
+
+  /// @brief Returns the stack size used for `size_class`.
+  static constexpr std::size_t size_of(stack_size_class size_class) noexcept {
+    switch (size_class) {
+    case stack_size_class::small:
+      return small_size;
+    case stack_size_class::large:
+      return large_size;
+    default:
+      return normal_size;
+    }
+  }
+
+  stack_t allocate() override;
+  stack_t allocate(stack_size_class size_class) override;
+  void deallocate(stack_t stack) override;
+};
+
+} // namespace stack
+} // namespace concore2full
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "concore2full/stack/stack_allocator.h"
+
+#include <utility>
+
+namespace concore2full {
+namespace stack {
+
+/// @brief A hint about how much stack a coroutine needs.
+enum class stack_size_class {
+  /// A few KB; e.g., leaf tasks, or the coroutines used internally to switch threads.
+  small,
+  /// The default stack size.
+  normal,
+  /// For deep recursion.
+  large,
+};
+
+/// @brief Type-erased source of coroutine stacks.
+///
+/// The library creates coroutines in many places (spawns, bulk spawns, thread switches, etc.); all
+/// of them obtain their stacks from a stack resource, which can be configured per thread pool and
+/// per spawn. Use `stack_resource_adaptor` to create a resource from any `stack_allocator`.
+class stack_resource {
+public:
+  virtual ~stack_resource() = default;
+
+  /// @brief Allocate a stack to be used for coroutines.
+  virtual stack_t allocate() = 0;
+  /// @brief Allocate a stack for a coroutine that needs `size_class` stack.
+  ///
+  /// Resources that don't distinguish between the size classes ignore the hint.
+  virtual stack_t allocate(stack_size_class size_class) {
+    (void)size_class;
+    return allocate();
+  }
+  /// @brief Deallocate a stack obtained from `allocate()`.
+  virtual void deallocate(stack_t stack) = 0;
+};
+
+/// @brief A stack resource that forwards to a `stack_allocator` object.
+template <stack_allocator A> class stack_resource_adaptor : public stack_resource {
+  A allocator_;
+
+public:
+  /// @brief Creates the resource, constructing the allocator from `args`.
+  template <typename... Ts>
+  explicit stack_resource_adaptor(Ts&&... args) : allocator_(std::forward<Ts>(args)...) {}
+
+  using stack_resource::allocate;
+  stack_t allocate() override { return allocator_.allocate(); }
+  void deallocate(stack_t stack) override { allocator_.deallocate(stack); }
+};
+
+/// @brief A stack allocator that obtains the stacks from a `stack_resource`.
+///
+/// This is what the library passes to `callcc`; the resource needs to outlive the coroutines.
+class resource_stack_allocator {
+  stack_resource* resource_;
+  stack_size_class size_class_;
+
+public:
+  /// @brief Initializes the allocator to use `resource`, for stacks of `size_class`.
+  explicit resource_stack_allocator(stack_resource& resource,
+                                    stack_size_class size_class = stack_size_class::normal) noexcept
+      : resource_(&resource), size_class_(size_class) {}
+
+  /// @brief Allocate a stack from the resource.
+  stack_t allocate() { return resource_->allocate(size_class_); }
+  /// @brief Give back the stack to the resource.
+  void deallocate(stack_t stack) { resource_->deallocate(stack); }
+};
+
+/// @brief Returns the stack resource used when nothing else is specified; pools the stacks, with a
+/// different pool for each `stack_size_class` (see `size_class_stack_resource`).
+stack_resource& default_stack_resource() noexcept;
+
+} // namespace stack
+} // namespace concore2full
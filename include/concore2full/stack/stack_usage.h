@@ -0,0 +1,168 @@
+#pragma once
+
+#include "concore2full/stack/mmap_stack_allocator.h"
+#include "concore2full/stack/simple_stack_allocator.h"
+#include "concore2full/stack/stack_allocator.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <source_location>
+
+namespace concore2full {
+namespace stack {
+
+/// @brief A site that creates coroutines, for which we measure the stack usage.
+///
+/// Sites are typically declared as static objects next to the code creating the coroutines, and
+/// are passed to `profiling_stack_allocator` (to measure the stack usage) and to
+/// `site_sized_stack_allocator` (to apply the learned stack size). All the sites are registered
+/// globally, so that `report_stack_usage()` can report on them.
+class stack_site {
+public:
+  /// The number of buckets in the histogram of the stack usage.
+  static constexpr int bucket_count = 16;
+  /// The upper limit of the first bucket; each bucket doubles the limit of the previous one.
+  static constexpr std::size_t first_bucket_limit = 1024;
+  /// The minimum stack size recommended for a site.
+  static constexpr std::size_t min_recommended_size = 16 * 1024;
+
+  /// @brief Creates and registers a site.
+  /// @param name The name of the site; if null, the source location is used.
+  /// @param location The location of the site in the source code.
+  explicit stack_site(const char* name = nullptr,
+                      std::source_location location = std::source_location::current()) noexcept;
+  ~stack_site();
+
+  stack_site(const stack_site&) = delete;
+  stack_site& operator=(const stack_site&) = delete;
+
+  /// @brief Records that a coroutine from this site used `bytes` of stack.
+  void record(std::size_t bytes) noexcept;
+
+  /// @brief The name of the site.
+  const char* name() const noexcept { return name_; }
+  /// @brief The location of the site in the source code.
+  const std::source_location& location() const noexcept { return location_; }
+  /// @brief The number of stacks measured.
+  uint64_t samples() const noexcept { return samples_.load(std::memory_order_relaxed); }
+  /// @brief The maximum stack usage measured.
+  std::size_t max_usage() const noexcept { return max_usage_.load(std::memory_order_relaxed); }
+  /// @brief The number of measured stacks whose usage falls into bucket `index`.
+  uint64_t bucket(int index) const noexcept {
+    return buckets_[index].load(std::memory_order_relaxed);
+  }
+
+  /// @brief Sets the stack size to be used for this site, e.g., learned in a previous run.
+  void set_size(std::size_t size) noexcept { size_.store(size, std::memory_order_relaxed); }
+  /// @brief Returns the stack size to be used for coroutines of this site.
+  ///
+  /// If a size was explicitly set, that size is returned. Otherwise, if the site has measurements,
+  /// returns twice the maximum measured usage, rounded up to 4 KB (at least
+  /// `min_recommended_size`). Otherwise, returns `fallback`.
+  std::size_t recommended_size(std::size_t fallback) const noexcept;
+
+  /// @brief Calls `f` for each registered site.
+  template <typename F> static void for_each(F&& f) {
+    lock_registry();
+    for (stack_site* s = first_; s; s = s->next_)
+      f(*s);
+    unlock_registry();
+  }
+
+private:
+  const char* name_;
+  std::source_location location_;
+  std::atomic<uint64_t> samples_{0};
+  std::atomic<std::size_t> max_usage_{0};
+  std::atomic<uint64_t> buckets_[bucket_count]{};
+  //! The size explicitly set for the site; zero if not set.
+  std::atomic<std::size_t> size_{0};
+  //! The sites are registered in an intrusive list.
+  stack_site* next_{nullptr};
+  stack_site* prev_{nullptr};
+
+  static stack_site* first_;
+  static void lock_registry() noexcept;
+  static void unlock_registry() noexcept;
+};
+
+/// @brief Writes a report with the stack usage for all the registered sites to `out`.
+///
+/// For each site, we report the number of measured stacks, the maximum usage, the recommended
+/// stack size, and the histogram of the stack usage.
+void report_stack_usage(std::FILE* out = stderr);
+
+namespace detail {
+//! Paints the memory of `stack` with a known pattern.
+void paint_stack(stack_t stack) noexcept;
+//! Returns the number of bytes at the top of `stack` that no longer have the paint pattern.
+std::size_t measure_stack_usage(stack_t stack) noexcept;
+} // namespace detail
+
+/// @brief A stack allocator that measures the stack usage of the coroutines, for a site.
+/// @tparam Upstream The allocator used to obtain the stacks.
+///
+/// On allocation, the entire stack is painted with a known pattern; on deallocation, the stack is
+/// scanned for the deepest location that no longer has the pattern (the *high-water mark*), and
+/// the result is recorded in the site. Painting touches all the stack memory, so this is meant to
+/// be used for measurements, not in production.
+template <stack_allocator Upstream = simple_stack_allocator> class profiling_stack_allocator {
+  stack_site* site_;
+  std::size_t size_;
+
+public:
+  /// The default stack size
+  static constexpr std::size_t default_size_ = Upstream::default_size_;
+
+  /// @brief Initializes the allocator for measuring the stack usage of `site`.
+  /// @param site The site for which we measure the stack usage.
+  /// @param size The size to be used for allocating stack. Default = 1MB
+  explicit profiling_stack_allocator(stack_site& site, std::size_t size = default_size_)
+      : site_(&site), size_(size) {}
+
+  /// @brief Allocate a painted stack to be used for coroutines.
+  /// @return Details about the allocated stack memory.
+  stack_t allocate() {
+    stack_t stack = Upstream{size_}.allocate();
+    detail::paint_stack(stack);
+    return stack;
+  }
+  /// @brief Measure the stack usage and deallocate the stack memory.
+  /// @param stack Object indicating the stack that needs to be deallocated.
+  void deallocate(stack_t stack) {
+    site_->record(detail::measure_stack_usage(stack));
+    Upstream{stack.size}.deallocate(stack);
+  }
+};
+
+/// @brief A stack allocator that uses the stack size learned for a site.
+/// @tparam Upstream The allocator used to obtain the stacks.
+///
+/// See `stack_site::recommended_size()`; if nothing is known about the site, the default stack size
+/// of `Upstream` is used.
+///
+/// The learned size is only as good as the measurements: a coroutine that takes a deeper path than
+/// the ones seen while profiling overflows its stack. With the default `Upstream`, stacks have a
+/// guard page, so the overflow crashes the program. With an upstream without guard pages (e.g.,
+/// `simple_stack_allocator`), the overflow silently corrupts the memory below the stack.
+template <stack_allocator Upstream = mmap_stack_allocator> class site_sized_stack_allocator {
+  stack_site* site_;
+
+public:
+  /// The default stack size
+  static constexpr std::size_t default_size_ = Upstream::default_size_;
+
+  /// @brief Initializes the allocator to use the stack size of `site`.
+  explicit site_sized_stack_allocator(stack_site& site) : site_(&site) {}
+
+  /// @brief Allocate a stack to be used for coroutines.
+  /// @return Details about the allocated stack memory.
+  stack_t allocate() { return Upstream{site_->recommended_size(default_size_)}.allocate(); }
+  /// @brief Deallocate the stack memory.
+  /// @param stack Object indicating the stack that needs to be deallocated.
+  void deallocate(stack_t stack) { Upstream{stack.size}.deallocate(stack); }
+};
+
+} // namespace stack
+} // namespace concore2full
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <exception>
+
+namespace concore2full {
+
+class stop_token;
+
+//! Exception thrown when awaiting a computation that was cancelled before it started.
+struct operation_cancelled : std::exception {
+  const char* what() const noexcept override { return "operation cancelled"; }
+};
+
+/**
+ * @brief Source of stop requests, for cooperative cancellation of spawned computations.
+ *
+ * A stop source may be chained to a parent token; a stop request on the parent is also visible on
+ * all the child sources. Unlike `std::stop_source`, this doesn't allocate any memory; checking for
+ * stop requests is just walking the (typically short) chain of parents.
+ *
+ * The source needs to outlive all the tokens obtained from it, and all the child sources.
+ */
+class stop_source {
+public:
+  //! Creates a source without a parent.
+  stop_source() = default;
+  //! Creates a source that is stopped when `parent` is stopped.
+  explicit stop_source(stop_token parent) noexcept;
+
+  stop_source(const stop_source&) = delete;
+  stop_source& operator=(const stop_source&) = delete;
+
+  //! Returns `true` if stop was requested on this source or on any of its parents.
+  bool stop_requested() const noexcept {
+    for (auto* s = this; s; s = s->parent_)
+      if (s->stop_requested_.load(std::memory_order_acquire))
+        return true;
+    return false;
+  }
+
+  //! Requests all the computations using this source (or its children) to stop.
+  void request_stop() noexcept { stop_requested_.store(true, std::memory_order_release); }
+
+  //! Returns a token that can be used to check for stop requests on this source.
+  stop_token get_token() const noexcept;
+
+private:
+  //! Set when a stop is requested directly on this source.
+  std::atomic<bool> stop_requested_{false};
+  //! The parent source, if any.
+  const stop_source* parent_{nullptr};
+};
+
+//! Token used for checking whether a stop was requested; cheap to copy.
+//! A default-constructed token is never stopped.
+class stop_token {
+public:
+  stop_token() = default;
+
+  //! Returns `true` if stop was requested on the source of this token.
+  bool stop_requested() const noexcept { return source_ && source_->stop_requested(); }
+
+  //! Returns `true` if this token is associated with a stop source.
+  bool stop_possible() const noexcept { return source_ != nullptr; }
+
+private:
+  //! The source of this token, if any.
+  const stop_source* source_{nullptr};
+
+  explicit stop_token(const stop_source* source) noexcept : source_(source) {}
+
+  friend class stop_source;
+};
+
+inline stop_source::stop_source(stop_token parent) noexcept : parent_(parent.source_) {}
+
+inline stop_token stop_source::get_token() const noexcept { return stop_token{this}; }
+
+} // namespace concore2full
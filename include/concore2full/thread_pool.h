@@ -4,6 +4,7 @@
 #include "concore2full/detail/catomic.h"
 #include "concore2full/detail/sleep_helper.h"
 #include "concore2full/profiling.h"
+#include "concore2full/stack/stack_resource.h"
 
 #include <cassert>
 #include <mutex>
@@ -26,6 +27,9 @@ public:
   thread_pool();
   //! Constructor. Using specified number of threads.
   explicit thread_pool(int num_threads);
+  //! Constructor. Using specified number of threads, and obtaining the stacks of the coroutines
+  //! created for the work of this pool from `stacks`. `stacks` needs to outlive the pool.
+  thread_pool(int num_threads, stack::stack_resource& stacks);
   //! Destructor. Waits for all the threads to be done.
   ~thread_pool();
 
@@ -47,6 +51,25 @@ public:
     }
   }
 
+  /**
+   * @brief Enqueue a task on a specific work line.
+   * @param task The task to be executed on this thread pool.
+   * @param work_line The work line to enqueue the task on; taken modulo the number of lines.
+   *
+   * The worker thread owning the work line is the first to look for the task, but the task can be
+   * stolen by other threads.
+   */
+  void enqueue_on(concore2full_task* task, int work_line) noexcept;
+
+  /**
+   * @brief Enqueue a list of tasks, linked through their `next_` fields.
+   * @param first The first task in the list.
+   *
+   * All the tasks are added to the same work line under a single lock, and up to one sleeping
+   * thread per task is woken up.
+   */
+  void enqueue_list(concore2full_task* first) noexcept;
+
   /**
    * @brief Extracts a task that was scheduled from execution.
    * @param task The task that should not be executed anymore.
@@ -68,6 +91,10 @@ public:
   //! Returns the number of threads in `this`.
   int available_parallelism() const noexcept { return threads_.size(); }
 
+  //! Returns the resource used to obtain the stacks of the coroutines created for the work of this
+  //! pool, unless the work specifies otherwise.
+  stack::stack_resource& stack_resource() const noexcept { return *stack_resource_; }
+
 private:
   //! Helper class that is used by threads to go to sleep, and to be woken up.
   class thread_sleep_data {
@@ -133,6 +160,9 @@ private:
     //! Removes `task` from the list of tasks.
     bool extract_task(concore2full_task* task) noexcept;
 
+    //! Pushes all the tasks linked from `first`; returns the number of pushed tasks.
+    int push_list(concore2full_task* first) noexcept;
+
   private:
     //! Mutex used to protect the access to the task list.
     std::mutex bottleneck_;
@@ -173,7 +203,12 @@ private:
   //! The threads that are doing the work.
   std::vector<std::thread> threads_;
 
+  //! The resource used to obtain the stacks of the coroutines.
+  stack::stack_resource* stack_resource_;
+
   void notify_one(int work_line_hint) noexcept;
+  //! Notifies that `count` tasks were added, waking up to `count` sleeping threads.
+  void notify_many(int work_line_hint, int count) noexcept;
 
   /**
    * @brief The main function to be executed by the worker threads
@@ -191,7 +226,8 @@ private:
   //! Execute work from the thread pool until `stop_condition` is set.
   //! Tries to use the work line with index `index_hint` first, but may use other lines, and can
   //! steal tasks from other threads. Sleeps on `sleep_object` if there are no tasks to execute.
-  void execute_work(std::stop_token stop_condition, int index_hint,
+  //! The tasks are told that they are executed by `worker_index` (negative for helping threads).
+  void execute_work(std::stop_token stop_condition, int index_hint, int worker_index,
                     thread_sleep_data& sleep_object) noexcept;
 };
 
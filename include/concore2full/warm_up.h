@@ -0,0 +1,60 @@
+#pragma once
+
+#include "concore2full/stack/stack_resource.h"
+#include "concore2full/thread_pool.h"
+
+#include <chrono>
+#include <cstddef>
+
+namespace concore2full {
+
+//! Options for `warm_up()`.
+struct warm_up_options {
+  //! The number of stacks to preallocate and prefault for each thread, for the spawned work. The
+  //! pooled stack resources cache at most 16 stacks of each size per thread; the extra stacks go to
+  //! the shared depots, which trim the stacks that stay idle.
+  int stacks_per_thread{4};
+  //! The size class of the stacks for the spawned work.
+  stack::stack_size_class size_class{stack::stack_size_class::normal};
+  //! The number of stacks to preallocate and prefault for each thread, for the coroutines that
+  //! switch threads (see `stack::stack_size_class::small`).
+  int switch_stacks_per_thread{2};
+  //! The number of bytes at the top of each stack to prefault; the whole stack if larger than the
+  //! stack.
+  std::size_t prefault_size{64 * 1024};
+};
+
+//! The outcome of `warm_up()`.
+struct warm_up_report {
+  //! The time taken by the warm-up.
+  std::chrono::nanoseconds duration{0};
+  //! The number of threads that were warmed up: the workers, plus the calling thread.
+  int thread_count{0};
+  //! The number of stacks that were allocated and prefaulted.
+  int stack_count{0};
+};
+
+/**
+ * @brief Prepares the global thread pool to execute work without startup costs.
+ * @param options Describes how much to warm up.
+ * @return The time taken, and the amount of work done.
+ *
+ * Without this, the first work spawned after the start of the program is much slower than the
+ * rest: the global thread pool is created on first use, the first coroutines page-fault their
+ * fresh stacks, and each thread registers itself for thread switching on first use. This creates
+ * the global thread pool, waits for all its workers to start, and, on each worker and on the
+ * calling thread, allocates the stacks that the work is likely to need and touches their memory;
+ * the stacks are then given back, so that the pooled stack resources (e.g., the default one) keep
+ * them ready for reuse in the caches of these threads. The pools don't trim the stacks of the
+ * thread caches as they become idle, so the warmed-up stacks stay resident until the work needs
+ * them; only explicit trim requests (e.g., `stack::trim_pooled_stacks()`) give them back to the OS.
+ *
+ * Must not be called from a worker of the thread pool, and the workers need to be idle; this
+ * occupies all the workers until they are all warmed up.
+ */
+warm_up_report warm_up(const warm_up_options& options = {});
+
+//! Same as `warm_up(options)`, but warms up `pool` instead of the global thread pool.
+warm_up_report warm_up(thread_pool& pool, const warm_up_options& options = {});
+
+} // namespace concore2full
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "concore2full/detail/await_group_frame.h"
+#include "concore2full/future.h"
+
+#include <cstddef>
+#include <span>
+#include <tuple>
+
+namespace concore2full {
+
+/**
+ * @brief Creates a future that completes when all the given futures complete.
+ * @param futures The futures to wait for; obtained from `spawn`, `escaping_spawn` or
+ * `copyable_spawn`.
+ * @return A future with a `void` result; this object cannot be copied or moved.
+ *
+ * Awaiting the returned future suspends the current thread of execution at most once for the
+ * entire group, instead of once per future. Computations that haven't started yet are executed in
+ * place by the awaiting thread.
+ *
+ * The given futures are not awaited; the caller still needs to call `await()` on them (in order
+ * to get the results), but these calls will complete immediately, without switching threads.
+ *
+ * The given futures must outlive the returned object, and must not be awaited before the returned
+ * future is awaited.
+ */
+template <typename... Futures> inline auto when_all(Futures&... futures) {
+  using frame_holder_t = detail::await_group_frame<std::tuple<Futures&...>, true>;
+  return future<frame_holder_t>{detail::start_spawn_t{}, std::tuple<Futures&...>{futures...}};
+}
+
+//! Same as `when_all(futures...)`, but waits for all the futures in a contiguous range.
+template <typename Future> inline auto when_all(std::span<Future> futures) {
+  using frame_holder_t = detail::await_group_frame<std::span<Future>, true>;
+  return future<frame_holder_t>{detail::start_spawn_t{}, futures};
+}
+
+//! The value yielded by a `when_any` future over no futures; it is not a valid index.
+inline constexpr std::size_t when_any_no_index = detail::empty_group_index;
+
+/**
+ * @brief Creates a future that completes when any of the given futures completes.
+ * @param futures The futures to wait for; obtained from `spawn`, `escaping_spawn` or
+ * `copyable_spawn`.
+ * @return A future that yields the index of the first future to complete; this object cannot be
+ * copied or moved.
+ *
+ * If there are no futures, the returned future completes immediately and yields
+ * `when_any_no_index`.
+ *
+ * Awaiting the returned future suspends the current thread of execution at most once. The
+ * remaining futures continue to run; the caller still needs to await all the given futures.
+ *
+ * The given futures must outlive the returned object, and must not be awaited before the returned
+ * future is awaited.
+ */
+template <typename... Futures> inline auto when_any(Futures&... futures) {
+  using frame_holder_t = detail::await_group_frame<std::tuple<Futures&...>, false>;
+  return future<frame_holder_t>{detail::start_spawn_t{}, std::tuple<Futures&...>{futures...}};
+}
+
+//! Same as `when_any(futures...)`, but waits for any of the futures in a contiguous range.
+template <typename Future> inline auto when_any(std::span<Future> futures) {
+  using frame_holder_t = detail::await_group_frame<std::span<Future>, false>;
+  return future<frame_holder_t>{detail::start_spawn_t{}, futures};
+}
+
+} // namespace concore2full
@@ -0,0 +1,37 @@
+#include "concore2full/detail/await_group.h"
+#include "concore2full/profiling.h"
+
+namespace concore2full::detail {
+
+await_group::await_group(uint32_t count, bool wait_for_all)
+    : pending_(count), wait_for_all_(wait_for_all) {
+  if (count == 0)
+    suspend_token_.notify();
+}
+
+void await_group::arrive(uint32_t index) noexcept {
+  uint32_t expected = no_index;
+  bool is_first =
+      first_arrived_.compare_exchange_strong(expected, index, std::memory_order_acq_rel);
+  // Sync: release all the writes of the completed member to the awaiting thread.
+  bool is_last = pending_.fetch_sub(1, std::memory_order_acq_rel) == 1;
+  if (is_last || (is_first && !wait_for_all_))
+    suspend_token_.notify();
+}
+
+bool await_group::is_done() const noexcept {
+  if (wait_for_all_)
+    return pending_.load(std::memory_order_acquire) == 0;
+  else
+    return first_arrived_.load(std::memory_order_acquire) != no_index;
+}
+
+void await_group::wait() {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  if (is_done())
+    return;
+  // Suspend only once for the entire group.
+  suspend_quick_resume(suspend_token_);
+}
+
+} // namespace concore2full::detail
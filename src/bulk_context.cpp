@@ -0,0 +1,23 @@
+#include "concore2full/bulk_context.h"
+#include "concore2full/current_thread_pool.h"
+
+#include <limits>
+#include <new>
+
+namespace concore2full {
+
+bulk_context::bulk_context() : bulk_context(current_thread_pool()) {}
+
+bulk_context::bulk_context(thread_pool& pool) {
+  using detail::bulk_context_frame;
+  using detail::bulk_spawn_frame_base;
+  // The number of tasks is bounded by the parallelism of the pool, so a frame sized for the
+  // maximum number of indices can be used for any number of indices.
+  size_t size_base_frame =
+      bulk_spawn_frame_base::frame_size(std::numeric_limits<int64_t>::max(), pool);
+  size_t total_size = sizeof(bulk_context_frame) - sizeof(bulk_spawn_frame_base) + size_base_frame;
+  frame_.reset(new (operator new(total_size)) bulk_context_frame{});
+  frame_->base_frame_.pool_ = &pool;
+}
+
+} // namespace concore2full
@@ -2,14 +2,17 @@
 #include "concore2full/c/spawn.h"
 #include "concore2full/detail/atomic_wait.h"
 #include "concore2full/detail/callcc.h"
-#include "concore2full/global_thread_pool.h"
+#include "concore2full/current_thread_pool.h"
 #include "concore2full/profiling.h"
 
+#include <algorithm>
 #include <chrono>
 #include <cstring>
+#include <thread>
 
 using concore2full::detail::bulk_spawn_frame_base;
 using concore2full::detail::callcc;
+using concore2full::detail::switch_stack_class;
 using concore2full::detail::continuation_t;
 
 namespace concore2full::detail {
@@ -18,18 +21,93 @@ struct concore2full_bulk_spawn_task : concore2full_task {
   bulk_spawn_frame_base* base_;
 };
 
+//! The range of work items owned by a task. Placed on its own cache line, as it is frequently
+//! updated by the owning task.
+struct alignas(64) bulk_range_slot {
+  //! Lock protecting `begin_` and `end_`.
+  std::atomic<bool> locked_{false};
+  //! The first work item in the range.
+  uint64_t begin_{0};
+  //! One past the last work item in the range.
+  uint64_t end_{0};
+  //! Bit `L` is set when one of the children of level `L` of the combining tree, rooted at this
+  //! task, has finished.
+  std::atomic<uint32_t> arrived_levels_{0};
+
+  void lock() noexcept {
+    while (locked_.exchange(true, std::memory_order_acquire)) {
+      while (locked_.load(std::memory_order_relaxed))
+        std::this_thread::yield();
+    }
+  }
+  void unlock() noexcept { locked_.store(false, std::memory_order_release); }
+
+  //! Take at most `max_take` work items from the front of the range, ignoring the work items at or
+  //! above `limit`; if `max_take` is zero, take a fraction of the remaining work items. Returns
+  //! false if there is nothing left to take.
+  bool claim_front(uint64_t max_take, uint64_t limit, uint64_t& begin, uint64_t& end) noexcept {
+    lock();
+    uint64_t last = std::min(end_, limit);
+    begin = begin_;
+    if (max_take == 0 && begin < last) {
+      // Leave enough work in the range, so that the others can still steal from us.
+      max_take = std::max((last - begin) / 16, uint64_t(1));
+    }
+    end = begin < last ? begin + std::min(max_take, last - begin) : begin;
+    // If we reached the limit, drop the rest of the range.
+    begin_ = end == begin ? end_ : end;
+    unlock();
+    return begin != end;
+  }
+
+  //! Steal the back half of the range, ignoring the work items at or above `limit`, and splitting
+  //! it at a multiple of `unit` work items; returns false if there is nothing left to steal.
+  bool steal_back(uint64_t unit, uint64_t limit, uint64_t& begin, uint64_t& end) noexcept {
+    lock();
+    end_ = std::max(begin_, std::min(end_, limit));
+    uint64_t remaining = end_ - begin_;
+    end = end_;
+    begin = begin_ + (remaining / unit) / 2 * unit;
+    end_ = begin;
+    unlock();
+    return begin != end;
+  }
+
+  //! Set the range of work items; only called when the range is empty.
+  void assign(uint64_t begin, uint64_t end) noexcept {
+    lock();
+    begin_ = begin;
+    end_ = end;
+    unlock();
+  }
+};
+
 } // namespace concore2full::detail
 
 namespace {
 
 continuation_t tombstone_continuation() { return (continuation_t)0x1; }
 
+//! The duration we aim for when executing a chunk of work items with automatic grain size.
+//! Large enough to amortize the cost of claiming chunks, small enough to keep load balancing.
+constexpr auto auto_chunk_duration = std::chrono::microseconds(50);
+
+//! The maximum number of work items in a chunk with automatic grain size.
+constexpr uint64_t max_auto_grain = 1 << 20;
+
+//! Returns the distance between partial results of `partial_size` bytes, such that each partial
+//! result is on different cache lines.
+uint32_t partial_stride(uint32_t partial_size) {
+  constexpr uint32_t cache_line = alignof(concore2full::detail::bulk_range_slot);
+  return (partial_size + cache_line - 1) / cache_line * cache_line;
+}
+
 } // namespace
 
 int bulk_spawn_frame_base::store_worker_continuation(continuation_t c) {
   // Occupy the next thread slot.
   int cont_index = atomic_fetch_add(&started_tasks_, 1);
-  assert(cont_index < count_);
+  assert(cont_index < task_count_);
   // Store the thread data to the proper continuation index.
   // This is different from the index of the task, as we may store the continuation out of order.
   threads_[cont_index].store(c, std::memory_order_release);
@@ -40,7 +118,7 @@ concore2full::detail::catomic<continuation_t>* bulk_spawn_frame_base::extract_co
   while (true) {
     // Obtain the index of the slot from which we need to extract.
     int index = atomic_fetch_add(&completed_tasks_, 1);
-    assert(index <= count_);
+    assert(index <= task_count_);
 
     auto* r = &threads_[index];
 
@@ -57,7 +135,7 @@ concore2full::detail::catomic<continuation_t>* bulk_spawn_frame_base::extract_co
 
 void bulk_spawn_frame_base::finalize_thread_of_execution(bool is_last_thread) {
   // Obtain the index of the slot from which we need to extract.
-  int count = count_;
+  int count = task_count_;
   atomic_fetch_add(&finalized_tasks_, 1);
   if (is_last_thread) {
     // Last thread needs to ensure that all other threads have finalized their maintenance work
@@ -67,16 +145,25 @@ void bulk_spawn_frame_base::finalize_thread_of_execution(bool is_last_thread) {
   // After this point, the `this` object may be destroyed (by the last thread).
 }
 
-void bulk_spawn_frame_base::execute_bulk_spawn_task(concore2full_task* t, int) noexcept {
+void bulk_spawn_frame_base::execute_bulk_spawn_task(concore2full_task* t,
+                                                    int worker_index) noexcept {
   auto task = reinterpret_cast<concore2full_bulk_spawn_task*>(t);
   auto frame = task->base_;
-  int index = (int)(task - frame->tasks_);
-  (void)callcc([frame, index](continuation_t thread_cont) -> continuation_t {
+  uint32_t index = uint32_t(task - frame->tasks_);
+  // Record the worker, not the line we were taken from; the next bulk spawn enqueues the task on
+  // the line owned by this worker.
+  if (frame->affinity_)
+    frame->affinity_[index] = worker_index;
+  auto& stacks = *frame->stacks_;
+  auto size_class = frame->size_class_;
+  (void)callcc(stacks, size_class, [frame, index](continuation_t thread_cont) -> continuation_t {
     // Store the current continuation, so that other threads can extract it.
     int cont_index = frame->store_worker_continuation(thread_cont);
 
     // Actually execute the given work.
-    frame->user_function_(frame->to_interface(), index);
+    frame->execute_work(index);
+    if (frame->combine_function_)
+      frame->combine_partials(index);
 
     // Extract the next free continuation data and switch to it.
     catomic<continuation_t>* cont_data = frame->extract_continuation();
@@ -89,7 +176,7 @@ void bulk_spawn_frame_base::execute_bulk_spawn_task(concore2full_task* t, int) n
       auto r = cont_data->load(std::memory_order_acquire);
       assert(r);
 
-      bool last_thread = cont_data == &frame->threads_[frame->count_];
+      bool last_thread = cont_data == &frame->threads_[frame->task_count_];
       frame->finalize_thread_of_execution(last_thread);
 
       return r;
@@ -97,55 +184,262 @@ void bulk_spawn_frame_base::execute_bulk_spawn_task(concore2full_task* t, int) n
   });
 }
 
-uint64_t bulk_spawn_frame_base::frame_size(int32_t count) {
+void bulk_spawn_frame_base::execute_work(uint32_t task_index) {
+  if (iterations_ > 1)
+    execute_supersteps(task_index);
+  else
+    execute_ranges(task_index);
+}
+
+void bulk_spawn_frame_base::execute_ranges(uint32_t task_index) {
+  bulk_range_slot& own = ranges_[task_index];
+  void* own_partial = combine_function_ ? partial(task_index) : nullptr;
+  uint64_t unit = grain_ > 0 ? grain_ : 1;
+  // With automatic grain, start with small chunks, and grow them while they execute fast. For
+  // per-index work, take a fraction of the remaining work items each time.
+  uint64_t take = grain_ > 0 || timed_chunks_ ? unit : 0;
+  uint64_t begin{0};
+  uint64_t end{0};
+  while (true) {
+    // Execute the work items from our own range.
+    while (own.claim_front(take, limit(), begin, end)) {
+      if (!timed_chunks_) {
+        range_function_(this->to_interface(), begin, end, own_partial);
+      } else {
+        auto start = std::chrono::steady_clock::now();
+        range_function_(this->to_interface(), begin, end, own_partial);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        if (elapsed < auto_chunk_duration && end - begin == take && take < max_auto_grain)
+          take *= 2;
+        else if (elapsed > 4 * auto_chunk_duration && take > 1)
+          take /= 2;
+      }
+      if (iterations_ > 1)
+        on_items_done(begin, end - begin);
+    }
+    // Our range is exhausted; try to steal work from the other tasks.
+    bool stolen = false;
+    for (uint32_t k = 1; k < task_count_ && !stolen; k++) {
+      stolen = ranges_[(task_index + k) % task_count_].steal_back(unit, limit(), begin, end);
+    }
+    if (!stolen)
+      return;
+    own.assign(begin, end);
+  }
+}
+
+void bulk_spawn_frame_base::execute_supersteps(uint32_t task_index) {
+  while (true) {
+    uint64_t step = current_step_.load(std::memory_order_acquire);
+    if (step >= iterations_)
+      return;
+    execute_ranges(task_index);
+    // Barrier: wait for the work items of the superstep that are executed by other threads of
+    // execution. We may have already executed work items from the next superstep.
+    atomic_wait(current_step_, [step](uint64_t s) { return s != step; });
+  }
+}
+
+void bulk_spawn_frame_base::on_items_done(uint64_t begin, uint64_t n) {
+  uint64_t done = step_done_items_.fetch_add(n, std::memory_order_acq_rel) + n;
+  if (done < count_)
+    return;
+  // We completed the last work items of the superstep; start the next one.
+  // The work items of the next superstep are visible before we advance `current_step_`, so they
+  // may be all completed before that; ensure we advance the steps in order.
+  uint64_t step = begin / count_;
+  atomic_wait(current_step_, [step](uint64_t s) { return s == step; });
+  step_done_items_.store(0, std::memory_order_relaxed);
+  if (step + 1 < iterations_)
+    assign_ranges((step + 1) * count_);
+  current_step_.store(step + 1, std::memory_order_release);
+}
+
+void bulk_spawn_frame_base::assign_ranges(uint64_t offset) {
+  // Evenly divide whole chunks between the tasks.
+  uint64_t unit = grain_ > 0 ? grain_ : 1;
+  uint64_t chunks = (count_ + unit - 1) / unit;
+  for (uint32_t i = 0; i < task_count_; i++) {
+    uint64_t begin = chunks * i / task_count_ * unit;
+    uint64_t end = std::min(chunks * (i + 1) / task_count_ * unit, count_);
+    ranges_[i].assign(offset + begin, offset + end);
+  }
+}
+
+void bulk_spawn_frame_base::combine_partials(uint32_t task_index) {
+  // At level `L` of the tree, the task with index `r` (multiple of 2^(L+1)) combines the results of
+  // the subtrees of `r` and `r + 2^L`; the combine is done by the last of the two to finish.
+  uint32_t r = task_index;
+  for (uint32_t level = 0; (1u << level) < task_count_; level++) {
+    uint32_t left = r & ~((2u << level) - 1);
+    uint32_t right = left + (1u << level);
+    if (right < task_count_) {
+      uint32_t bit = 1u << level;
+      if ((ranges_[left].arrived_levels_.fetch_or(bit, std::memory_order_acq_rel) & bit) == 0)
+        return; // The other subtree is not done yet; the last one to finish will combine.
+      combine_function_(to_interface(), partial(left), partial(right));
+    }
+    r = left;
+  }
+}
+
+uint32_t bulk_spawn_frame_base::task_count(int64_t count, thread_pool& pool) {
+  // One task per worker thread, plus one for the thread that awaits.
+  int64_t tasks = std::min(int64_t(pool.available_parallelism()) + 1, int64_t(max_task_count));
+  return uint32_t(std::min(count, tasks));
+}
+
+void bulk_spawn_frame_base::execute_each(concore2full_bulk_spawn_frame* frame, uint64_t begin,
+                                         uint64_t end, void*) noexcept {
+  auto* self = from_interface(frame);
+  for (uint64_t i = begin; i < end; i++)
+    self->user_function_(frame, i);
+}
+
+uint64_t bulk_spawn_frame_base::frame_size(int64_t count) {
+  // Don't depend on the current thread pool; the frame may be spawned on a different one.
+  return frame_size_for_tasks(uint64_t(std::min(count, int64_t(max_task_count))), 0);
+}
+
+uint64_t bulk_spawn_frame_base::frame_size(int64_t count, thread_pool& pool) {
+  return frame_size(count, pool, 0);
+}
+
+uint64_t bulk_spawn_frame_base::frame_size(int64_t count, thread_pool& pool,
+                                           uint32_t partial_size) {
+  return frame_size_for_tasks(task_count(count, pool), partial_size);
+}
+
+uint64_t bulk_spawn_frame_base::frame_size_for_tasks(uint64_t tasks, uint32_t partial_size) {
   return sizeof(bulk_spawn_frame_base)                   //
-         + count * sizeof(concore2full_bulk_spawn_task)  //
-         + (count + 1) * sizeof(catomic<continuation_t>) //
+         + tasks * sizeof(concore2full_bulk_spawn_task)  //
+         + (tasks + 1) * sizeof(catomic<continuation_t>) //
+         + alignof(bulk_range_slot) - 1                  //
+         + tasks * sizeof(bulk_range_slot)               //
+         + tasks * partial_stride(partial_size)          //
       ;
 }
 
-void bulk_spawn_frame_base::spawn(int32_t count, concore2full_bulk_spawn_function_t f) {
+void bulk_spawn_frame_base::spawn(int64_t count, concore2full_bulk_spawn_function_t f) {
+  spawn(count, f, concore2full::current_thread_pool());
+}
+
+void bulk_spawn_frame_base::spawn(int64_t count, concore2full_bulk_spawn_function_t f,
+                                  thread_pool& pool) {
+  user_function_ = f;
+  spawn_chunked(count, per_index_grain, &execute_each, pool);
+}
+
+void bulk_spawn_frame_base::spawn_chunked(int64_t count, int64_t grain, bulk_range_function_t f,
+                                          thread_pool& pool) {
+  prepare(count, grain, f, pool);
+  start();
+}
+
+void bulk_spawn_frame_base::prepare(int64_t count, int64_t grain, bulk_range_function_t f,
+                                    thread_pool& pool, bulk_combine_function_t combine,
+                                    uint32_t partial_size) {
+  // We need at most one task per chunk.
+  uint64_t unit = grain > 0 ? uint64_t(grain) : 1;
+  uint64_t chunks = (uint64_t(count) + unit - 1) / unit;
+  uint32_t tasks = task_count(int64_t(chunks), pool);
   size_t size_struct = sizeof(bulk_spawn_frame_base);
-  size_t size_tasks = count * sizeof(concore2full_bulk_spawn_task);
+  size_t size_tasks = tasks * sizeof(concore2full_bulk_spawn_task);
+  size_t size_threads = (tasks + 1) * sizeof(catomic<continuation_t>);
   char* p = reinterpret_cast<char*>(this);
   tasks_ = reinterpret_cast<concore2full_bulk_spawn_task*>(p + size_struct);
   threads_ = reinterpret_cast<catomic<continuation_t>*>(p + size_struct + size_tasks);
+  uintptr_t ranges_addr = reinterpret_cast<uintptr_t>(p + size_struct + size_tasks + size_threads);
+  constexpr uintptr_t ranges_align = alignof(bulk_range_slot);
+  ranges_addr = (ranges_addr + ranges_align - 1) & ~(ranges_align - 1);
+  ranges_ = reinterpret_cast<bulk_range_slot*>(ranges_addr);
+  // The partial results follow the ranges, and are also aligned to cache lines.
+  partials_ = reinterpret_cast<char*>(ranges_ + tasks);
+  partial_stride_ = combine ? partial_stride(partial_size) : 0;
 
   count_ = count;
+  task_count_ = tasks;
+  grain_ = uint64_t(std::max(grain, int64_t(0)));
+  timed_chunks_ = grain == 0;
   started_tasks_ = 0;
   completed_tasks_ = 0;
   finalized_tasks_ = 0;
-  user_function_ = f;
-  for (int i = 0; i < count; i++) {
+  range_function_ = f;
+  combine_function_ = combine;
+  pool_ = &pool;
+  affinity_ = nullptr;
+  stacks_ = &pool.stack_resource();
+  size_class_ = stack::stack_size_class::normal;
+  for (uint32_t i = 0; i < tasks; i++) {
     tasks_[i].task_function_ = &execute_bulk_spawn_task;
     tasks_[i].next_ = nullptr;
     tasks_[i].base_ = this;
   }
-  for (int i = 0; i < count + 1; i++) {
+  for (uint32_t i = 0; i < tasks + 1; i++) {
     threads_[i] = catomic<continuation_t>{};
   }
+  for (uint32_t i = 0; i < tasks; i++) {
+    new (&ranges_[i]) bulk_range_slot{};
+  }
+  assign_ranges(0);
+  iterations_ = 1;
+  current_step_.store(0, std::memory_order_relaxed);
+  step_done_items_.store(0, std::memory_order_relaxed);
+  limit_.store(UINT64_MAX, std::memory_order_relaxed);
+}
+
+void bulk_spawn_frame_base::set_iterations(uint64_t iterations) { iterations_ = iterations; }
+
+void bulk_spawn_frame_base::start() {
+  if (!affinity_) {
+    pool_->enqueue_bulk(tasks_, int(task_count_));
+    return;
+  }
+  for (uint32_t i = 0; i < task_count_; i++) {
+    if (affinity_[i] >= 0)
+      pool_->enqueue_on(&tasks_[i], affinity_[i]);
+    else
+      pool_->enqueue(&tasks_[i]);
+  }
+}
 
-  concore2full::global_thread_pool().enqueue_bulk(tasks_, count);
+void bulk_spawn_frame_base::stop_after(uint64_t index) noexcept {
+  assert(iterations_ == 1);
+  uint64_t new_limit = index + 1;
+  uint64_t old_limit = limit_.load(std::memory_order_relaxed);
+  while (new_limit < old_limit &&
+         !limit_.compare_exchange_weak(old_limit, new_limit, std::memory_order_relaxed))
+    ;
 }
 
 void bulk_spawn_frame_base::await() {
   concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // We may continue on a different OS thread; keep the current thread pool of our control flow.
+  concore2full::detail::preserve_current_thread_pool preserve_pool;
 
   // If all the workers have finished, we can return directly.
   uint64_t completed = atomic_load_explicit(&completed_tasks_, std::memory_order_acquire);
-  if (completed == uint64_t(count_))
+  if (completed == uint64_t(task_count_))
     return;
 
   // Try to execute as much as possible inplace.
-  for (uint32_t i = 0; i < count_; i++) {
-    if (concore2full::global_thread_pool().extract_task(&tasks_[i])) {
+  // The work items are claimed from the ranges of the tasks, so we only need to probe the queue for
+  // the tasks that are not yet started; stop as soon as all of them are started.
+  for (uint32_t i = 0; i < task_count_; i++) {
+    if (started_tasks_.load(std::memory_order_relaxed) == task_count_)
+      break;
+    if (pool_->extract_task(&tasks_[i])) {
       // Occupy one slot in the completed tasks.
       store_worker_continuation(tombstone_continuation());
 
       {
         concore2full::profiling::zone z{CURRENT_LOCATION_N("execute inplace")};
         // Actually execute the given work.
-        user_function_(this->to_interface(), i);
+        if (affinity_)
+          affinity_[i] = -1;
+        execute_work(i);
+        if (combine_function_)
+          combine_partials(i);
       }
 
       finalize_thread_of_execution(false);
@@ -153,20 +447,20 @@ void bulk_spawn_frame_base::await() {
   }
 
   // We may need to switching threads, so we need a continuation.
-  auto c = callcc([this](continuation_t await_cc) -> continuation_t {
+  auto c = callcc(*stacks_, switch_stack_class, [this](continuation_t await_cc) -> continuation_t {
     // Store the current continuation, so that other threads can extract it.
-    // We always store the continuation at `count_` position, so that this is the last one to be
-    // extracted.
+    // We always store the continuation at `task_count_` position, so that this is the last one to
+    // be extracted.
     concore2full::profiling::zone await_zone{CURRENT_LOCATION_N("await")};
     await_zone.set_param("ctx", (uint64_t)await_cc);
-    threads_[count_].store(await_cc, std::memory_order_release);
+    threads_[task_count_].store(await_cc, std::memory_order_release);
 
     // Extract the next free continuation data and switch to it.
     auto c1 = extract_continuation();
     auto r = c1->load(std::memory_order_relaxed);
     assert(r);
 
-    bool last_thread = c1 == &threads_[count_];
+    bool last_thread = c1 == &threads_[task_count_];
     finalize_thread_of_execution(last_thread);
 
     return r;
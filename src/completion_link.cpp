@@ -0,0 +1,73 @@
+#include "concore2full/detail/completion_link.h"
+#include "concore2full/detail/atomic_wait.h"
+
+#include <cassert>
+
+namespace concore2full::detail {
+
+uintptr_t completion_link::lock() noexcept {
+  uintptr_t v = state_.load(std::memory_order_acquire);
+  while (true) {
+    if (v & locked_bit) {
+      // Somebody else holds the lock; wait for it to be released.
+      atomic_wait(state_, [](uintptr_t s) { return (s & locked_bit) == 0; });
+      v = state_.load(std::memory_order_acquire);
+      continue;
+    }
+    // If the computation is completed, we don't need to lock anything.
+    if (v & completed_bit)
+      return v;
+    if (state_.compare_exchange_weak(v, v | locked_bit, std::memory_order_acquire))
+      return v;
+  }
+}
+
+bool completion_link::attach(completion_observer* observer) noexcept {
+  uintptr_t v = lock();
+  if (v & completed_bit)
+    return false;
+  // Add the observer at the front of the list, and unlock.
+  observer->next_ = reinterpret_cast<completion_observer*>(v);
+  state_.store(reinterpret_cast<uintptr_t>(observer), std::memory_order_release);
+  return true;
+}
+
+bool completion_link::detach(completion_observer* observer) noexcept {
+  uintptr_t v = lock();
+  if (v & completed_bit) {
+    // The observer is notified; wait for the notification to complete.
+    atomic_wait(observer->notified_, [](bool notified) { return notified; });
+    return false;
+  }
+  // Remove the observer from the list.
+  auto* head = reinterpret_cast<completion_observer*>(v);
+  for (completion_observer** link = &head; *link; link = &(*link)->next_) {
+    if (*link == observer) {
+      *link = observer->next_;
+      break;
+    }
+  }
+  // Unlock.
+  state_.store(reinterpret_cast<uintptr_t>(head), std::memory_order_release);
+  return true;
+}
+
+completion_observer* completion_link::start_notify() noexcept {
+  uintptr_t v = lock();
+  assert((v & completed_bit) == 0);
+  // Take the list of observers, and mark the computation as completed.
+  state_.store(completed_bit, std::memory_order_release);
+  return reinterpret_cast<completion_observer*>(v);
+}
+
+void completion_link::finish_notify(completion_observer* observers) noexcept {
+  while (observers) {
+    // Read the next pointer first; the observer may be destroyed after it is notified.
+    auto* next = observers->next_;
+    observers->on_complete_(observers);
+    observers->notified_.store(true, std::memory_order_release);
+    observers = next;
+  }
+}
+
+} // namespace concore2full::detail
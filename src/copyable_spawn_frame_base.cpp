@@ -1,6 +1,7 @@
 #include "concore2full/detail/copyable_spawn_frame_base.h"
 #include "concore2full/detail/atomic_wait.h"
-#include "concore2full/global_thread_pool.h"
+#include "concore2full/detail/quick_resume_task.h"
+#include "concore2full/current_thread_pool.h"
 #include "concore2full/profiling.h"
 
 #include <chrono>
@@ -9,8 +10,12 @@
 namespace {
 
 using concore2full::detail::callcc;
+using concore2full::detail::helping_stack_class;
+using concore2full::detail::switch_stack_class;
+using concore2full::detail::completion_link;
 using concore2full::detail::continuation_t;
 using concore2full::detail::copyable_spawn_frame_base;
+using concore2full::detail::quick_resume_task;
 
 /*
 Valid transitions:
@@ -26,31 +31,34 @@ enum sync_state_values {
   ss_all_done,
 };
 
+//! Marks the list of late awaiters as closed; no more awaiters can be added to it.
+concore2full_task* closed_list() { return reinterpret_cast<concore2full_task*>(0x1); }
+
 } // namespace
 
 void copyable_spawn_frame_base::spawn(concore2full_spawn_function_t f) {
+  spawn(f, concore2full::current_thread_pool());
+}
+void copyable_spawn_frame_base::spawn(concore2full_spawn_function_t f, thread_pool& pool) {
   sync_state_.set_name("sync_state");
   task_.task_function_ = &execute_spawn_task;
   task_.next_ = nullptr;
   sync_state_ = ss_initial_state;
   user_function_ = f;
-  concore2full::global_thread_pool().enqueue(&task_);
+  late_awaiters_.store(nullptr, std::memory_order_relaxed);
+  pool_ = &pool;
+  pool_->enqueue(&task_);
 }
 void copyable_spawn_frame_base::await() {
   concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // We may continue on a different OS thread; keep the current thread pool of our control flow.
+  concore2full::detail::preserve_current_thread_pool preserve_pool;
   if (awaiters_count_.fetch_add(1, std::memory_order_acquire) == 0) {
     // We are the first awaiter
 
     // If the async work hasn't started yet, check if we can execute it here directly.
     if (sync_state_.load(std::memory_order_acquire) == ss_initial_state) {
-      if (concore2full::global_thread_pool().extract_task(&task_)) {
-        concore2full::profiling::zone z{CURRENT_LOCATION_N("execute inplace")};
-        // We've extracted the task from the queue; execute it here directly.
-        user_function_(to_interface());
-        // Tell other awaits that the async work has finished.
-        sync_state_.store(ss_all_done, std::memory_order_release);
-        // Notify all the waiting futures.
-        suspend_token_.notify();
+      if (execute_inplace_if_queued()) {
         // We are done; return regularly.
         return;
       }
@@ -62,7 +70,8 @@ void copyable_spawn_frame_base::await() {
     uint32_t expected{ss_async_started};
     if (sync_state_.compare_exchange_strong(expected, ss_main_finishing)) {
       // We are the first to finish; we need to start switching threads.
-      auto c = callcc([this](continuation_t await_cc) -> continuation_t {
+      auto& stacks = pool_->stack_resource();
+      auto c = callcc(stacks, switch_stack_class, [this](continuation_t await_cc) {
         first_await_ = await_cc;
         auto continue_with = secondary_thread_;
         // We are done "finishing".
@@ -86,11 +95,28 @@ void copyable_spawn_frame_base::await() {
       return;
     }
 
-    // Suspend the current thread; let the worker wake us up,
-    suspend_quick_resume(suspend_token_);
+    // Park the current control flow; the worker will resume us.
+    park_late_awaiter();
   }
 }
 
+bool copyable_spawn_frame_base::execute_inplace_if_queued() {
+  if (sync_state_.load(std::memory_order_acquire) != ss_initial_state ||
+      !pool_->extract_task(&task_))
+    return false;
+
+  concore2full::profiling::zone z{CURRENT_LOCATION_N("execute inplace")};
+  // We've extracted the task from the queue; execute it here directly.
+  user_function_(to_interface());
+  // Tell other awaits that the async work has finished.
+  sync_state_.store(ss_all_done, std::memory_order_release);
+  // Resume all the late awaiters.
+  resume_late_awaiters();
+  // Notify the observers, if any.
+  completion_.finish_notify(completion_.start_notify());
+  return true;
+}
+
 //! Called when the async work is finished, to see if we need a thread switch.
 continuation_t copyable_spawn_frame_base::on_async_complete(continuation_t c) {
   concore2full::profiling::zone zone{CURRENT_LOCATION()};
@@ -98,8 +124,8 @@ continuation_t copyable_spawn_frame_base::on_async_complete(continuation_t c) {
   uint32_t expected{ss_async_started};
   if (sync_state_.compare_exchange_strong(expected, ss_async_finishing)) {
     // We are first to arrive at completion.
-    // Notify futures that may arrive at the wait location immediately after this.
-    suspend_token_.notify();
+    // Resume the late awaiters; this needs to happen before the frame can be dropped.
+    resume_late_awaiters();
     // Tell the world that the computation has finished; here the frame may be dropped
     sync_state_.store(ss_all_done, std::memory_order_release);
     // We won't need any thread switch, just return the original continuation.
@@ -114,26 +140,78 @@ continuation_t copyable_spawn_frame_base::on_async_complete(continuation_t c) {
     // Tell the world that the computation has finished.
     sync_state_.store(ss_all_done, std::memory_order_release);
 
-    // Notify all the waiting futures.
-    suspend_token_.notify();
+    // Resume all the late awaiters.
+    resume_late_awaiters();
 
     // Finish the thread switch.
     return first_await_;
   }
 }
 
+void copyable_spawn_frame_base::park_late_awaiter() {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  auto& stacks = pool_->stack_resource();
+  // We help the thread pool from this coroutine; its tasks run inline, on our stack.
+  (void)callcc(stacks, helping_stack_class, [this](continuation_t after_suspend) -> continuation_t {
+    // Once we are linked in the list, the frame may be destroyed at any time (after the awaiting
+    // control flow is resumed); get everything we need from the frame first.
+    auto& pool = *pool_;
+    auto done = done_.get_token();
+    quick_resume_task task{after_suspend, pool.stack_resource()};
+
+    // Add ourselves to the list of late awaiters, unless the list is closed.
+    auto* head = late_awaiters_.load(std::memory_order_acquire);
+    do {
+      if (head == closed_list()) {
+        // The computation has completed; continue directly.
+        return after_suspend;
+      }
+      task.next_ = head;
+    } while (!late_awaiters_.compare_exchange_weak(head, &task, std::memory_order_release,
+                                                   std::memory_order_acquire));
+
+    // Help the thread pool until the computation is complete.
+    pool.offer_help_until(done);
+
+    // At this point our task is enqueued; try to extract it, to continue on the same thread.
+    if (pool.extract_task(&task)) {
+      return after_suspend;
+    } else {
+      // The task got the chance to run; we need to resume at the point that the task left it.
+      concore2full::detail::atomic_wait(task.after_execute_,
+                                        [](continuation_t c) { return c != nullptr; });
+      return task.after_execute_.load(std::memory_order_acquire);
+    }
+  });
+}
+
+void copyable_spawn_frame_base::resume_late_awaiters() noexcept {
+  // Close the list; awaiters that come after this point don't need to be parked.
+  auto* awaiters = late_awaiters_.exchange(closed_list(), std::memory_order_acq_rel);
+  // Enqueue all the parked awaiters at once.
+  if (awaiters)
+    pool_->enqueue_list(awaiters);
+  // Wake up the threads that are helping while the awaiters are parked.
+  done_.request_stop();
+}
+
 //! The task function that executes the async work.
 void copyable_spawn_frame_base::execute_spawn_task(concore2full_task* task, int) noexcept {
   auto self =
       (copyable_spawn_frame_base*)((char*)task - offsetof(copyable_spawn_frame_base, task_));
-  (void)callcc([self](continuation_t thread_cont) -> continuation_t {
+  auto& stacks = self->pool_->stack_resource();
+  (void)callcc(stacks, [self](continuation_t thread_cont) -> continuation_t {
     // Assume there will be a thread switch and store required objects.
     self->secondary_thread_ = thread_cont;
     // Signal the fact that we have started (and the continuation is properly stored).
     self->sync_state_.store(ss_async_started, std::memory_order_release);
     // Actually execute the given work.
     self->user_function_(self->to_interface());
-    // Complete the async processing.
-    return self->on_async_complete(thread_cont);
+    // Complete the async processing, notifying the observers (if any).
+    auto* observers = self->completion_.start_notify();
+    auto next = self->on_async_complete(thread_cont);
+    // The observers keep the frame alive until they are notified.
+    completion_link::finish_notify(observers);
+    return next;
   });
 }
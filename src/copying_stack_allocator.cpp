@@ -0,0 +1,224 @@
+#include "concore2full/stack/copying_stack_allocator.h"
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace concore2full::stack {
+
+namespace {
+
+//! The smallest slot size.
+constexpr std::size_t min_slot_size = 16 * 1024;
+//! The maximum number of slots reserved for each slot size.
+constexpr std::size_t max_slots = std::size_t(1) << 22;
+//! If we cannot reserve `max_slots` slots, we try with fewer, but not less than this.
+constexpr std::size_t min_slots = 1024;
+//! The maximum number of different slot sizes.
+constexpr int max_regions = 8;
+
+//! The granularity of the offsets of the stack tops inside the slots.
+constexpr std::size_t color_step = 64;
+//! The number of different offsets of the stack tops inside the slots. Without these offsets, the
+//! tops of all the stacks would have the same alignment, and would map to the same cache sets.
+constexpr std::size_t color_count = 64;
+
+//! The copy of the used part of a parked stack; the bytes of the stack follow this header.
+struct saved_stack {
+  std::size_t size_;
+};
+
+//! A reserved address range, divided into slots of the same size.
+struct region {
+  char* base_;
+  char* end_;
+  std::size_t slot_size_;
+  std::size_t slot_count_;
+  //! For each slot, the copy of the stack, if the coroutine is parked.
+  std::atomic<saved_stack*>* saved_;
+
+  //! Protects `free_slots_` and `next_unused_`.
+  std::mutex bottleneck_;
+  //! The slots that were deallocated; reused in LIFO order, as they are likely to be resident.
+  std::vector<std::size_t> free_slots_;
+  //! The first slot that was never used.
+  std::size_t next_unused_{0};
+
+  bool contains(const void* sp) const noexcept {
+    auto* p = static_cast<const char*>(sp);
+    return p > base_ && p <= end_;
+  }
+  std::size_t slot_of(const void* sp) const noexcept {
+    return std::size_t(static_cast<const char*>(sp) - base_ - 1) / slot_size_;
+  }
+  char* slot_begin(std::size_t slot) const noexcept { return base_ + slot * slot_size_; }
+  //! The top of the stack placed in `slot`.
+  char* stack_top(std::size_t slot) const noexcept {
+    return slot_begin(slot + 1) - (slot % color_count) * color_step;
+  }
+  //! The size of the stacks placed in the slots.
+  std::size_t stack_size() const noexcept { return slot_size_ - color_count * color_step; }
+};
+
+//! The regions created so far; never destroyed, as the stacks may be used after the static objects
+//! are destroyed.
+std::atomic<region*> g_regions[max_regions];
+//! Protects the creation of the regions.
+std::mutex g_regions_bottleneck;
+
+std::atomic<int64_t> g_parked_count{0};
+std::atomic<int64_t> g_parked_bytes{0};
+
+//! Returns the region that contains `sp`, or null if `sp` is not on a stack from a region.
+region* find_region(const void* sp) noexcept {
+  for (auto& r : g_regions) {
+    region* p = r.load(std::memory_order_acquire);
+    if (!p)
+      return nullptr;
+    if (p->contains(sp))
+      return p;
+  }
+  return nullptr;
+}
+
+//! Reserves the address range for a region with slots of `slot_size` bytes; null on failure.
+region* create_region(std::size_t slot_size) {
+  constexpr int prot = PROT_READ | PROT_WRITE;
+  constexpr int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+  for (std::size_t count = max_slots; count >= min_slots; count /= 2) {
+    void* mem = mmap(nullptr, count * slot_size, prot, flags, -1, 0);
+    if (mem == MAP_FAILED)
+      continue;
+    // The memory is zero-initialized, and is committed lazily.
+    void* saved = mmap(nullptr, count * sizeof(std::atomic<saved_stack*>), prot, flags, -1, 0);
+    if (saved == MAP_FAILED) {
+      munmap(mem, count * slot_size);
+      return nullptr;
+    }
+    auto* r = new region;
+    r->base_ = static_cast<char*>(mem);
+    r->end_ = r->base_ + count * slot_size;
+    r->slot_size_ = slot_size;
+    r->slot_count_ = count;
+    r->saved_ = static_cast<std::atomic<saved_stack*>*>(saved);
+    return r;
+  }
+  return nullptr;
+}
+
+//! Returns the region for slots of `slot_size` bytes, creating it if needed.
+region& region_for(std::size_t slot_size) {
+  for (auto& r : g_regions) {
+    region* p = r.load(std::memory_order_acquire);
+    if (!p)
+      break;
+    if (p->slot_size_ == slot_size)
+      return *p;
+  }
+  std::lock_guard<std::mutex> lock{g_regions_bottleneck};
+  for (auto& r : g_regions) {
+    region* p = r.load(std::memory_order_acquire);
+    if (p && p->slot_size_ == slot_size)
+      return *p;
+    if (!p) {
+      p = create_region(slot_size);
+      if (!p)
+        throw std::bad_alloc();
+      r.store(p, std::memory_order_release);
+      return *p;
+    }
+  }
+  throw std::bad_alloc();
+}
+
+} // namespace
+
+stack_t copying_stack_allocator::allocate() {
+  region& r = region_for(std::bit_ceil(std::max(size_, min_slot_size)));
+  std::size_t slot;
+  {
+    std::lock_guard<std::mutex> lock{r.bottleneck_};
+    if (!r.free_slots_.empty()) {
+      slot = r.free_slots_.back();
+      r.free_slots_.pop_back();
+    } else if (r.next_unused_ < r.slot_count_) {
+      slot = r.next_unused_++;
+    } else {
+      throw std::bad_alloc();
+    }
+  }
+  return {r.stack_size(), r.stack_top(slot)};
+}
+
+void copying_stack_allocator::deallocate(stack_t stack) {
+  region* r = find_region(stack.sp);
+  assert(r);
+  std::size_t slot = r->slot_of(stack.sp);
+  assert(r->saved_[slot].load(std::memory_order_relaxed) == nullptr);
+  std::lock_guard<std::mutex> lock{r->bottleneck_};
+  r->free_slots_.push_back(slot);
+}
+
+int64_t copying_stack_allocator::parked_count() noexcept {
+  return g_parked_count.load(std::memory_order_relaxed);
+}
+
+int64_t copying_stack_allocator::parked_bytes() noexcept {
+  return g_parked_bytes.load(std::memory_order_relaxed);
+}
+
+namespace detail {
+
+bool park_stack(void* sp, const void* shared) noexcept {
+  region* r = find_region(sp);
+  if (!r)
+    return false;
+  std::size_t slot = r->slot_of(sp);
+  char* top = r->stack_top(slot);
+  auto* begin = static_cast<char*>(sp);
+  auto* s = static_cast<const char*>(shared);
+  if (s >= begin && s < top)
+    return false;
+
+  // Copy the used part of the stack; the memory below `sp` is not in use.
+  std::size_t used = std::size_t(top - begin);
+  auto* saved = static_cast<saved_stack*>(std::malloc(sizeof(saved_stack) + used));
+  if (!saved)
+    return false;
+  saved->size_ = used;
+  std::memcpy(saved + 1, begin, used);
+  // Give the memory of the entire slot back to the OS; we keep the address range reserved.
+  madvise(r->slot_begin(slot), r->slot_size_, MADV_DONTNEED);
+
+  r->saved_[slot].store(saved, std::memory_order_relaxed);
+  g_parked_count.fetch_add(1, std::memory_order_relaxed);
+  g_parked_bytes.fetch_add(int64_t(used), std::memory_order_relaxed);
+  return true;
+}
+
+void unpark_stack(void* sp) noexcept {
+  region* r = find_region(sp);
+  if (!r)
+    return;
+  std::size_t slot = r->slot_of(sp);
+  saved_stack* saved = r->saved_[slot].exchange(nullptr, std::memory_order_relaxed);
+  if (!saved)
+    return;
+  // Restore the stack at the same addresses.
+  std::memcpy(r->stack_top(slot) - saved->size_, saved + 1, saved->size_);
+  g_parked_count.fetch_sub(1, std::memory_order_relaxed);
+  g_parked_bytes.fetch_sub(int64_t(saved->size_), std::memory_order_relaxed);
+  std::free(saved);
+}
+
+} // namespace detail
+
+} // namespace concore2full::stack
@@ -0,0 +1,33 @@
+#include "concore2full/current_thread_pool.h"
+#include "concore2full/global_thread_pool.h"
+
+namespace concore2full {
+
+namespace {
+//! The thread pool set for the control flow running on the current OS thread.
+//! When a control flow moves to another OS thread, the value is carried over by
+//! `detail::preserve_current_thread_pool`.
+thread_local thread_pool* tls_current_pool{nullptr};
+} // namespace
+
+thread_pool& current_thread_pool() noexcept {
+  auto* pool = tls_current_pool;
+  return pool ? *pool : global_thread_pool();
+}
+
+scoped_thread_pool::scoped_thread_pool(thread_pool& pool) noexcept
+    : previous_(detail::current_thread_pool_override()) {
+  detail::set_current_thread_pool_override(&pool);
+}
+
+scoped_thread_pool::~scoped_thread_pool() { detail::set_current_thread_pool_override(previous_); }
+
+namespace detail {
+
+thread_pool* current_thread_pool_override() noexcept { return tls_current_pool; }
+
+void set_current_thread_pool_override(thread_pool* pool) noexcept { tls_current_pool = pool; }
+
+} // namespace detail
+
+} // namespace concore2full
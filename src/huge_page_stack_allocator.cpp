@@ -0,0 +1,125 @@
+#include "concore2full/stack/huge_page_stack_allocator.h"
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <vector>
+
+namespace concore2full::stack {
+
+namespace {
+
+using page_kind = huge_page_stack_allocator::page_kind;
+
+//! The size of an arena; holds several stacks of the default size.
+constexpr std::size_t arena_size = 16 * huge_page_stack_allocator::huge_page_size_;
+
+//! The granularity of the stack sizes carved from the arenas.
+constexpr std::size_t stack_granularity = 64 * 1024;
+
+//! The gap left after each stack carved from an arena. Without it, the tops of all the stacks would
+//! have the same alignment, and would map to the same cache sets; the hottest part of the stacks
+//! would then compete for a few cache lines.
+constexpr std::size_t stack_gap = 4 * 1024 + 64;
+
+//! The arenas from which we carve the stacks, and the stacks that are free.
+struct arena_state {
+  std::mutex bottleneck_;
+  //! The next free byte in the current arena.
+  char* next_{nullptr};
+  //! The end of the current arena.
+  char* end_{nullptr};
+  //! The free stacks, by size; each entry is the top of a stack.
+  std::unordered_map<std::size_t, std::vector<void*>> free_stacks_;
+  //! The kind of pages used by the last arena.
+  std::atomic<page_kind> last_kind_{page_kind::normal};
+};
+
+arena_state& global_arenas() {
+  // Never destroyed, as stacks may be deallocated after the static objects are destroyed.
+  static arena_state* instance = new arena_state;
+  return *instance;
+}
+
+//! Maps `size` bytes (multiple of the huge page size) of memory aligned to the huge page size,
+//! preferring huge pages; sets `kind` to the kind of pages used. Returns null on failure.
+char* map_arena(std::size_t size, page_kind& kind) {
+  constexpr std::size_t huge = huge_page_stack_allocator::huge_page_size_;
+#ifdef MAP_HUGETLB
+  // Try explicit huge pages; this fails if the system doesn't have enough reserved huge pages.
+  void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+                 -1, 0);
+  if (p != MAP_FAILED) {
+    kind = page_kind::explicit_huge;
+    return static_cast<char*>(p);
+  }
+#endif
+  // Map more than needed, so that we can align the arena to the huge page size.
+  void* raw = mmap(nullptr, size + huge, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (raw == MAP_FAILED)
+    return nullptr;
+  uintptr_t begin = reinterpret_cast<uintptr_t>(raw);
+  uintptr_t aligned = (begin + huge - 1) & ~uintptr_t(huge - 1);
+  if (aligned > begin)
+    munmap(raw, aligned - begin);
+  munmap(reinterpret_cast<void*>(aligned + size), begin + huge - aligned);
+  char* arena = reinterpret_cast<char*>(aligned);
+  kind = page_kind::normal;
+#ifdef MADV_HUGEPAGE
+  if (madvise(arena, size, MADV_HUGEPAGE) == 0)
+    kind = page_kind::transparent;
+#endif
+  return arena;
+}
+
+} // namespace
+
+stack_t huge_page_stack_allocator::allocate() {
+  std::size_t size = (size_ + stack_granularity - 1) / stack_granularity * stack_granularity;
+  arena_state& arenas = global_arenas();
+  std::lock_guard<std::mutex> lock{arenas.bottleneck_};
+
+  // Reuse a free stack of the same size, if we have one.
+  auto& free_list = arenas.free_stacks_[size];
+  if (!free_list.empty()) {
+    void* top = free_list.back();
+    free_list.pop_back();
+    return {size, top};
+  }
+
+  // Carve a new stack from the current arena, creating a new arena if needed.
+  if (std::size_t(arenas.end_ - arenas.next_) < size + stack_gap) {
+    std::size_t needed = size + stack_gap;
+    std::size_t new_arena_size =
+        std::max(arena_size, (needed + huge_page_size_ - 1) / huge_page_size_ * huge_page_size_);
+    page_kind kind;
+    char* arena = map_arena(new_arena_size, kind);
+    if (!arena)
+      throw std::bad_alloc();
+    arenas.last_kind_.store(kind, std::memory_order_relaxed);
+    // Any remaining space in the old arena is lost.
+    arenas.next_ = arena;
+    arenas.end_ = arena + new_arena_size;
+  }
+  char* mem = arenas.next_;
+  arenas.next_ += size + stack_gap;
+  return {size, mem + size};
+}
+
+void huge_page_stack_allocator::deallocate(stack_t stack) {
+  arena_state& arenas = global_arenas();
+  std::lock_guard<std::mutex> lock{arenas.bottleneck_};
+  arenas.free_stacks_[stack.size].push_back(stack.sp);
+}
+
+huge_page_stack_allocator::page_kind huge_page_stack_allocator::arena_page_kind() noexcept {
+  return global_arenas().last_kind_.load(std::memory_order_relaxed);
+}
+
+} // namespace concore2full::stack
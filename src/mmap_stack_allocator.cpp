@@ -0,0 +1,37 @@
+#include "concore2full/stack/mmap_stack_allocator.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <new>
+
+namespace concore2full::stack {
+
+std::size_t mmap_stack_allocator::page_size() noexcept {
+  static const std::size_t size = std::size_t(sysconf(_SC_PAGESIZE));
+  return size;
+}
+
+stack_t mmap_stack_allocator::allocate() {
+  std::size_t page = page_size();
+  std::size_t size = (size_ + page - 1) / page * page;
+  // Reserve the stack and the guard page; the pages are committed when they are first touched.
+  void* mem = mmap(nullptr, size + page, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (mem == MAP_FAILED)
+    throw std::bad_alloc();
+  // The stack grows downwards; put the guard page at the lowest address.
+  if (mprotect(mem, page, PROT_NONE) != 0) {
+    munmap(mem, size + page);
+    throw std::bad_alloc();
+  }
+  return {size, static_cast<char*>(mem) + page + size};
+}
+
+void mmap_stack_allocator::deallocate(stack_t stack) {
+  std::size_t page = page_size();
+  void* mem = static_cast<char*>(stack.sp) - stack.size - page;
+  munmap(mem, stack.size + page);
+}
+
+} // namespace concore2full::stack
@@ -0,0 +1,332 @@
+#include "concore2full/stack/pooled_stack_allocator.h"
+
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iterator>
+#include <mutex>
+#include <thread>
+
+namespace concore2full::stack::detail {
+
+namespace {
+
+//! The maximum number of free stacks kept by a thread, for each pool.
+constexpr int thread_cache_capacity = 16;
+//! The number of stacks moved at once between a thread cache and the global depot.
+constexpr int batch_size = thread_cache_capacity / 2;
+//! The maximum number of free stacks kept in the global depot of a pool.
+constexpr int depot_capacity = 64;
+//! The maximum number of pools (i.e., upstream allocators and stack sizes) that have thread caches;
+//! the pools created after these many only use their depots.
+constexpr int max_cached_pools = 8;
+
+//! The number of pools created so far.
+std::atomic<int> pool_count{0};
+//! The last pool created; the pools are linked through `next_pool_`.
+std::atomic<stack_pool*> last_pool{nullptr};
+
+//! Returns the current time of a coarse monotonic clock, in nanoseconds. Cheap enough to be called
+//! every time a stack is given back.
+int64_t coarse_now() noexcept {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+  return int64_t(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+}
+
+//! Returns the stack stored in the free stack `s` of `size` bytes.
+stack_t to_stack(free_stack* s, std::size_t size) noexcept {
+  return {size, reinterpret_cast<char*>(s + 1)};
+}
+
+//! Returns the free stack stored in `stack`.
+free_stack* to_free_stack(stack_t stack) noexcept {
+  return reinterpret_cast<free_stack*>(stack.sp) - 1;
+}
+
+//! Gives back to the OS the memory of `stack`, except its top; returns the number of resident bytes
+//! released.
+std::size_t trim_stack(stack_t stack) noexcept {
+  static const uintptr_t page = uintptr_t(sysconf(_SC_PAGESIZE));
+  uintptr_t top = reinterpret_cast<uintptr_t>(stack.sp);
+  uintptr_t begin = (top - stack.size + page - 1) & ~(page - 1);
+  uintptr_t end = (top - trim_keep_size) & ~(page - 1);
+  if (end <= begin)
+    return 0;
+  // Find out how much of the memory is resident, before releasing it.
+  std::size_t resident_pages = 0;
+  constexpr std::size_t chunk_pages = 256;
+  unsigned char resident[chunk_pages];
+  for (uintptr_t p = begin; p < end; p += chunk_pages * page) {
+    std::size_t n = std::min(chunk_pages, (end - p) / page);
+    if (mincore(reinterpret_cast<void*>(p), n * page, resident) == 0)
+      resident_pages += std::size_t(
+          std::count_if(resident, resident + n, [](unsigned char r) { return r & 1; }));
+  }
+  if (madvise(reinterpret_cast<void*>(begin), end - begin, MADV_DONTNEED) != 0)
+    return 0;
+  return resident_pages * page;
+}
+
+} // namespace
+
+//! The free stacks of the current thread, for one pool; given back to the pool when the thread
+//! exits.
+struct thread_stack_cache {
+  stack_pool* pool_{nullptr};
+  free_stack_list stacks_;
+  //! The last trim request of the pool seen by this cache.
+  uint32_t trim_epoch_{0};
+
+  ~thread_stack_cache() {
+    if (pool_) {
+      pool_->give_to_depot(stacks_, stacks_.count_);
+      pool_->release(stacks_);
+    }
+  }
+};
+
+namespace {
+
+//! The states of the caches of a thread, with respect to the trimming from other threads.
+enum cache_state_values {
+  //! The thread may use its caches; only the thread itself accesses them.
+  cs_active = 0,
+  //! The thread is blocked; other threads may trim its caches.
+  cs_idle,
+  //! Another thread is trimming the caches.
+  cs_trimming,
+};
+
+//! The caches of the current thread, for all the pools. The threads that become idle are
+//! registered, so that the trim requests can reach their caches while they are blocked.
+struct thread_stack_caches {
+  thread_stack_cache caches_[max_cached_pools];
+  //! The state of the caches, as seen by the other threads; see `cache_state_values`.
+  std::atomic<int> state_{cs_active};
+  //! True if the caches are in the list of registered caches.
+  bool registered_{false};
+  thread_stack_caches* next_{nullptr};
+  thread_stack_caches* prev_{nullptr};
+
+  ~thread_stack_caches();
+
+  //! Returns true if the thread has used any of the pools.
+  bool has_caches() const noexcept {
+    return std::any_of(std::begin(caches_), std::end(caches_),
+                       [](const thread_stack_cache& c) { return c.pool_ != nullptr; });
+  }
+};
+
+//! Protects the list of registered caches.
+std::mutex registry_bottleneck;
+//! The caches of the threads that were idle at least once; the ones of the other threads are never
+//! accessed by other threads.
+thread_stack_caches* first_registered{nullptr};
+
+thread_stack_caches::~thread_stack_caches() {
+  if (!registered_)
+    return;
+  std::lock_guard<std::mutex> lock{registry_bottleneck};
+  (prev_ ? prev_->next_ : first_registered) = next_;
+  if (next_)
+    next_->prev_ = prev_;
+}
+
+thread_local thread_stack_caches tls_caches;
+
+} // namespace
+
+stack_pool::stack_pool(std::size_t stack_size, release_t release) noexcept
+    : index_(pool_count.fetch_add(1, std::memory_order_relaxed)), stack_size_(stack_size),
+      release_(release) {
+  next_pool_ = last_pool.load(std::memory_order_relaxed);
+  while (!last_pool.compare_exchange_weak(next_pool_, this, std::memory_order_release,
+                                          std::memory_order_relaxed))
+    ;
+}
+
+bool stack_pool::try_take(stack_t& stack) noexcept {
+  if (index_ >= max_cached_pools) {
+    // No thread cache for this pool; take the stack directly from the depot.
+    free_stack_list taken;
+    if (available_.load(std::memory_order_relaxed) > 0)
+      take_from_depot(taken, 1);
+    if (taken.count_ == 0)
+      return false;
+    stack = to_stack(taken.pop(), stack_size_);
+    return true;
+  }
+  thread_stack_cache& cache = tls_caches.caches_[index_];
+  cache.pool_ = this;
+  trim_thread_cache_if_requested(cache);
+  free_stack_list& local = cache.stacks_;
+  if (local.count_ == 0 && available_.load(std::memory_order_relaxed) > 0) {
+    // Try to refill the cache from the depot.
+    take_from_depot(local, batch_size);
+  }
+  if (local.count_ == 0)
+    return false;
+  stack = to_stack(local.pop(), stack_size_);
+  return true;
+}
+
+void stack_pool::give_back(stack_t stack) noexcept {
+  free_stack* s = to_free_stack(stack);
+  s->idle_since_ = coarse_now();
+  s->trimmed_ = false;
+  if (index_ >= max_cached_pools) {
+    // No thread cache for this pool; give the stack directly to the depot, if it fits.
+    free_stack_list given;
+    given.push(s);
+    give_to_depot(given, 1);
+    release(given);
+    return;
+  }
+  thread_stack_cache& cache = tls_caches.caches_[index_];
+  cache.pool_ = this;
+  trim_thread_cache_if_requested(cache);
+  free_stack_list& local = cache.stacks_;
+  if (local.count_ == thread_cache_capacity) {
+    // Move a batch of stacks to the depot; release the ones that don't fit.
+    free_stack_list overflow;
+    local.move_to(overflow, batch_size);
+    if (available_.load(std::memory_order_relaxed) < depot_capacity)
+      give_to_depot(overflow, batch_size);
+    release(overflow);
+  }
+  local.push(s);
+}
+
+std::size_t stack_pool::trim(std::chrono::nanoseconds min_idle) noexcept {
+  // Ask the other threads to trim their caches.
+  trim_min_idle_.store(min_idle.count(), std::memory_order_relaxed);
+  trim_epoch_.fetch_add(1, std::memory_order_release);
+
+  int64_t now = coarse_now();
+  std::size_t released = 0;
+  if (index_ < max_cached_pools) {
+    thread_stack_cache& cache = tls_caches.caches_[index_];
+    cache.pool_ = this;
+    cache.trim_epoch_ = trim_epoch_.load(std::memory_order_relaxed);
+    released = trim(cache.stacks_, min_idle.count(), now);
+  }
+  if (index_ < max_cached_pools)
+    released += trim_idle_thread_caches(min_idle.count(), now);
+  std::lock_guard<std::mutex> lock{bottleneck_};
+  return released + trim(depot_, min_idle.count(), now);
+}
+
+void stack_pool::take_from_depot(free_stack_list& to, int n) noexcept {
+  int64_t now = coarse_now();
+  std::lock_guard<std::mutex> lock{bottleneck_};
+  if (now - last_idle_check_ >= idle_trim_threshold.count()) {
+    (void)trim(depot_, idle_trim_threshold.count(), now);
+    last_idle_check_ = now;
+  }
+  depot_.move_to(to, n);
+  available_.store(depot_.count_, std::memory_order_relaxed);
+}
+
+void stack_pool::give_to_depot(free_stack_list& from, int n) noexcept {
+  int64_t now = coarse_now();
+  std::lock_guard<std::mutex> lock{bottleneck_};
+  if (now - last_idle_check_ >= idle_trim_threshold.count()) {
+    (void)trim(depot_, idle_trim_threshold.count(), now);
+    last_idle_check_ = now;
+  }
+  from.move_to(depot_, std::min(n, depot_capacity - depot_.count_));
+  available_.store(depot_.count_, std::memory_order_relaxed);
+}
+
+void stack_pool::release(free_stack_list& stacks) noexcept {
+  while (stacks.head_)
+    release_(to_stack(stacks.pop(), stack_size_));
+}
+
+std::size_t stack_pool::trim(free_stack_list& stacks, int64_t min_idle, int64_t now) noexcept {
+  std::size_t released = 0;
+  for (free_stack* s = stacks.head_; s; s = s->next_) {
+    if (!s->trimmed_ && now - s->idle_since_ >= min_idle) {
+      released += trim_stack(to_stack(s, stack_size_));
+      s->trimmed_ = true;
+    }
+  }
+  return released;
+}
+
+void stack_pool::trim_thread_cache_if_requested(thread_stack_cache& cache) noexcept {
+  uint32_t epoch = trim_epoch_.load(std::memory_order_acquire);
+  if (cache.trim_epoch_ == epoch)
+    return;
+  cache.trim_epoch_ = epoch;
+  (void)trim(cache.stacks_, trim_min_idle_.load(std::memory_order_relaxed), coarse_now());
+}
+
+std::size_t stack_pool::trim_idle_thread_caches(int64_t min_idle, int64_t now) noexcept {
+  uint32_t epoch = trim_epoch_.load(std::memory_order_relaxed);
+  std::size_t released = 0;
+  std::lock_guard<std::mutex> lock{registry_bottleneck};
+  for (thread_stack_caches* t = first_registered; t; t = t->next_) {
+    // Sync: acquire the cache from the thread that became idle; skip the threads that are active.
+    int expected = cs_idle;
+    if (!t->state_.compare_exchange_strong(expected, cs_trimming, std::memory_order_acquire,
+                                           std::memory_order_relaxed))
+      continue;
+    thread_stack_cache& cache = t->caches_[index_];
+    if (cache.pool_ == this) {
+      cache.trim_epoch_ = epoch;
+      released += trim(cache.stacks_, min_idle, now);
+    }
+    // Sync: release the changes to the cache back to the thread.
+    t->state_.store(cs_idle, std::memory_order_release);
+  }
+  return released;
+}
+
+void begin_thread_idle() noexcept {
+  thread_stack_caches& caches = tls_caches;
+  if (!caches.registered_) {
+    // Nothing to trim if the thread never used the pools.
+    if (!caches.has_caches())
+      return;
+    std::lock_guard<std::mutex> lock{registry_bottleneck};
+    caches.next_ = first_registered;
+    if (first_registered)
+      first_registered->prev_ = &caches;
+    first_registered = &caches;
+    caches.registered_ = true;
+  }
+  // Sync: release the changes to our caches to the threads that trim them.
+  caches.state_.store(cs_idle, std::memory_order_release);
+}
+
+void end_thread_idle() noexcept {
+  thread_stack_caches& caches = tls_caches;
+  // Only other threads can change an idle state, and only back to idle.
+  if (caches.state_.load(std::memory_order_relaxed) == cs_active)
+    return;
+  int expected = cs_idle;
+  // Sync: acquire the changes made by the threads that trimmed our caches.
+  while (!caches.state_.compare_exchange_weak(expected, cs_active, std::memory_order_acquire,
+                                              std::memory_order_relaxed)) {
+    expected = cs_idle;
+    std::this_thread::yield();
+  }
+}
+
+} // namespace concore2full::stack::detail
+
+namespace concore2full::stack {
+
+std::size_t trim_pooled_stacks(std::chrono::nanoseconds min_idle) {
+  std::size_t released = 0;
+  auto* pool = detail::last_pool.load(std::memory_order_acquire);
+  for (; pool; pool = pool->next_pool_)
+    released += pool->trim(min_idle);
+  return released;
+}
+
+} // namespace concore2full::stack
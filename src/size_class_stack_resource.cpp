@@ -0,0 +1,42 @@
+#include "concore2full/stack/size_class_stack_resource.h"
+#include "concore2full/stack/pooled_stack_allocator.h"
+
+namespace concore2full::stack {
+
+namespace {
+template <std::size_t Size>
+using pooled_allocator = basic_pooled_stack_allocator<simple_stack_allocator, Size>;
+using small_allocator = pooled_allocator<size_class_stack_resource::small_size>;
+using normal_allocator = pooled_allocator<size_class_stack_resource::normal_size>;
+using large_allocator = pooled_allocator<size_class_stack_resource::large_size>;
+} // namespace
+
+stack_t size_class_stack_resource::allocate() { return normal_allocator{}.allocate(); }
+
+stack_t size_class_stack_resource::allocate(stack_size_class size_class) {
+  switch (size_class) {
+  case stack_size_class::small:
+    return small_allocator{}.allocate();
+  case stack_size_class::large:
+    return large_allocator{}.allocate();
+  default:
+    return normal_allocator{}.allocate();
+  }
+}
+
+void size_class_stack_resource::deallocate(stack_t stack) {
+  // The size of the stack tells us the class it was allocated for.
+  switch (stack.size) {
+  case small_size:
+    small_allocator{}.deallocate(stack);
+    break;
+  case large_size:
+    large_allocator{}.deallocate(stack);
+    break;
+  default:
+    normal_allocator{}.deallocate(stack);
+    break;
+  }
+}
+
+} // namespace concore2full::stack
@@ -1,5 +1,6 @@
 #include "concore2full/detail/sleep_helper.h"
 #include "concore2full/profiling.h"
+#include "concore2full/stack/pooled_stack_allocator.h"
 
 #include "thread_info.h"
 
@@ -23,7 +24,10 @@ sleep_helper::sleep_helper()
 
 void sleep_helper::sleep() {
   concore2full::detail::check_for_thread_switch();
+  // While we are blocked, let the trim requests from other threads reach our cached stacks.
+  concore2full::stack::detail::begin_thread_idle();
   concore2full::detail::sleep(current_thread_, sleep_id_);
+  concore2full::stack::detail::end_thread_idle();
 }
 
 wakeup_token sleep_helper::get_wakeup_token() {
@@ -2,14 +2,21 @@
 #include "concore2full/detail/bulk_spawn_frame_base.h"
 #include "concore2full/detail/spawn_frame_base.h"
 
+#include <new>
+
 namespace {
 
 using concore2full::detail::bulk_spawn_frame_base;
 using concore2full::detail::spawn_frame_base;
 
+static_assert(sizeof(spawn_frame_base) <= sizeof(concore2full_spawn_frame),
+              "`concore2full_spawn_frame` is too small to hold a spawn frame");
+
 } // namespace
 
 void concore2full_spawn(concore2full_spawn_frame* frame, concore2full_spawn_function_t f) {
+  // The frame is raw memory provided by the caller; construct the frame in it first.
+  new (frame) spawn_frame_base();
   spawn_frame_base::from_interface(frame)->spawn(f);
 }
 
@@ -17,9 +24,9 @@ void concore2full_await(concore2full_spawn_frame* frame) {
   spawn_frame_base::from_interface(frame)->await();
 }
 
-uint64_t concore2full_frame_size(int32_t count) { return bulk_spawn_frame_base::frame_size(count); }
+uint64_t concore2full_frame_size(int64_t count) { return bulk_spawn_frame_base::frame_size(count); }
 
-void concore2full_bulk_spawn(struct concore2full_bulk_spawn_frame* frame, int32_t count,
+void concore2full_bulk_spawn(struct concore2full_bulk_spawn_frame* frame, int64_t count,
                              concore2full_bulk_spawn_function_t f) {
   bulk_spawn_frame_base::from_interface(frame)->spawn(count, f);
 }
@@ -32,7 +39,7 @@ void concore2full_spawn2(concore2full_spawn_frame* frame, concore2full_spawn_fun
   concore2full_spawn(frame, *f);
 }
 
-void concore2full_bulk_spawn2(struct concore2full_bulk_spawn_frame* frame, int32_t* count,
+void concore2full_bulk_spawn2(struct concore2full_bulk_spawn_frame* frame, int64_t* count,
                               concore2full_bulk_spawn_function_t* f) {
   concore2full_bulk_spawn(frame, *count, *f);
 }
@@ -1,7 +1,8 @@
 #include "concore2full/detail/spawn_frame_base.h"
 #include "concore2full/detail/atomic_wait.h"
-#include "concore2full/global_thread_pool.h"
+#include "concore2full/current_thread_pool.h"
 #include "concore2full/profiling.h"
+#include "concore2full/stack/copying_stack_allocator.h"
 
 #include <chrono>
 #include <cstring>
@@ -9,39 +10,58 @@
 namespace {
 
 using concore2full::detail::callcc;
+using concore2full::detail::completion_link;
 using concore2full::detail::continuation_t;
 using concore2full::detail::spawn_frame_base;
+using concore2full::detail::switch_stack_class;
 
 /*
 Valid transitions:
-ss_initial_state -> ss_async_started --> ss_async_finished
-                                     \-> ss_main_finishing -> ss_main_finished
+ss_not_spawned -> ss_initial_state -> ss_async_started --> ss_async_finished
+                                   |                   \-> ss_main_finishing -> ss_main_finished
+                                   \-> ss_cancelled
 */
 enum sync_state_values {
-  ss_initial_state = 0,
+  ss_not_spawned = 0,
+  ss_initial_state,
   ss_async_started,
   ss_async_finished,
   ss_main_finishing,
   ss_main_finished,
+  ss_cancelled,
 };
 
 } // namespace
 
 void spawn_frame_base::spawn(concore2full_spawn_function_t f) {
+  spawn(f, concore2full::current_thread_pool());
+}
+void spawn_frame_base::spawn(concore2full_spawn_function_t f, thread_pool& pool,
+                             stop_token token, stack::stack_resource* stacks,
+                             stack::stack_size_class size_class) {
   task_.task_function_ = &execute_spawn_task;
   task_.next_ = nullptr;
-  sync_state_ = ss_initial_state;
   user_function_ = f;
-  concore2full::global_thread_pool().enqueue(&task_);
+  stop_token_ = token;
+  pool_ = &pool;
+  stacks_ = stacks ? stacks : &pool.stack_resource();
+  size_class_ = size_class;
+  // Note: the completion link is not reset; observers may be attached before we are spawned (e.g.,
+  // for `then_frame`). Sync: publishes the above fields to `execute_inplace_if_queued()`.
+  atomic_store_explicit(&sync_state_, ss_initial_state, std::memory_order_release);
+  pool_->enqueue(&task_);
 }
-void spawn_frame_base::await() {
+void spawn_frame_base::await() { await_impl(false); }
+void spawn_frame_base::await_parked() { await_impl(true); }
+void spawn_frame_base::await_impl(bool allow_parking) {
+  // We may continue on a different OS thread; keep the current thread pool of our control flow.
+  concore2full::detail::preserve_current_thread_pool preserve_pool;
   // If the async work hasn't started yet, check if we can execute it here directly.
   if (atomic_load_explicit(&sync_state_, std::memory_order_acquire) == ss_initial_state) {
-    if (concore2full::global_thread_pool().extract_task(&task_)) {
-      concore2full::profiling::zone z{CURRENT_LOCATION_N("execute inplace")};
-      // We've extracted the task from the queue; execute it here directly.
-      user_function_(to_interface());
-      // We are done.
+    if (execute_inplace_if_queued()) {
+      // We are done, unless the computation was dropped.
+      if (atomic_load_explicit(&sync_state_, std::memory_order_relaxed) == ss_cancelled)
+        throw operation_cancelled{};
       return;
     }
     // If we are here, the task was already started by the thread pool.
@@ -52,20 +72,56 @@ void spawn_frame_base::await() {
   uint32_t expected{ss_async_started};
   if (atomic_compare_exchange_strong(&sync_state_, &expected, ss_main_finishing)) {
     // The main thread is first to finish; we need to start switching threads.
-    auto c = callcc([this](continuation_t await_cc) -> continuation_t {
+    auto c = callcc(*stacks_, switch_stack_class, [this, allow_parking](continuation_t await_cc) {
       originator_ = await_cc;
+      // While we wait, release the stack memory of the awaiting coroutine, if the caller allows it.
+      if (allow_parking)
+        concore2full::stack::detail::park_stack(await_cc, this);
       // We are done "finishing".
       atomic_store_explicit(&sync_state_, ss_main_finished, std::memory_order_release);
       // Complete the thread switching.
       return secondary_thread_;
     });
     (void)c;
+  } else if (expected == ss_cancelled) {
+    // The computation was dropped without being executed.
+    throw operation_cancelled{};
   } else {
     // The async thread finished; we can continue directly, no need to switch threads.
   }
   // This point will be executed by the thread that finishes last.
 }
 
+bool spawn_frame_base::execute_inplace_if_queued() {
+  if (atomic_load_explicit(&sync_state_, std::memory_order_acquire) != ss_initial_state ||
+      !pool_->extract_task(&task_))
+    return false;
+
+  // We've extracted the task from the queue; we don't need to execute it if a stop was requested.
+  if (drop_if_stop_requested())
+    return true;
+
+  concore2full::profiling::zone z{CURRENT_LOCATION_N("execute inplace")};
+  // Execute the task here directly.
+  user_function_(to_interface());
+  // Later awaits don't need to switch threads.
+  atomic_store_explicit(&sync_state_, ss_async_finished, std::memory_order_release);
+  // Notify the observers, if any.
+  completion_.finish_notify(completion_.start_notify());
+  return true;
+}
+
+bool spawn_frame_base::drop_if_stop_requested() noexcept {
+  if (!stop_token_.stop_requested())
+    return false;
+  // Nobody is waiting for the computation to start, so we can finish directly.
+  auto* observers = completion_.start_notify();
+  atomic_store_explicit(&sync_state_, ss_cancelled, std::memory_order_release);
+  // Here, the frame may be destroyed; the observers are kept alive until they are notified.
+  completion_link::finish_notify(observers);
+  return true;
+}
+
 //! Called when the async work is finished, to see if we need a thread switch.
 continuation_t spawn_frame_base::on_async_complete(continuation_t c) {
   uint32_t expected{ss_async_started};
@@ -82,6 +138,7 @@ continuation_t spawn_frame_base::on_async_complete(continuation_t c) {
     concore2full::detail::atomic_wait(sync_state_, [](int v) { return v == ss_main_finished; });
 
     // Finish the thread switch.
+    concore2full::stack::detail::unpark_stack(originator_);
     return originator_;
   }
 }
@@ -89,14 +146,22 @@ continuation_t spawn_frame_base::on_async_complete(continuation_t c) {
 //! The task function that executes the async work.
 void spawn_frame_base::execute_spawn_task(concore2full_task* task, int) noexcept {
   auto self = (spawn_frame_base*)((char*)task - offsetof(spawn_frame_base, task_));
-  (void)callcc([self](continuation_t thread_cont) -> continuation_t {
+  // If a stop was requested, drop the computation without creating a new stack for it.
+  if (self->drop_if_stop_requested())
+    return;
+  auto& stacks = *self->stacks_;
+  (void)callcc(stacks, self->size_class_, [self](continuation_t thread_cont) -> continuation_t {
     // Assume there will be a thread switch and store required objects.
     self->secondary_thread_ = thread_cont;
     // Signal the fact that we have started (and the continuation is properly stored).
     atomic_store_explicit(&self->sync_state_, ss_async_started, std::memory_order_release);
     // Actually execute the given work.
     self->user_function_(self->to_interface());
-    // Complete the async processing.
-    return self->on_async_complete(thread_cont);
+    // Complete the async processing, notifying the observers (if any).
+    auto* observers = self->completion_.start_notify();
+    auto next = self->on_async_complete(thread_cont);
+    // The observers keep the frame alive until they are notified.
+    completion_link::finish_notify(observers);
+    return next;
   });
 }
@@ -0,0 +1,12 @@
+#include "concore2full/stack/stack_resource.h"
+#include "concore2full/stack/size_class_stack_resource.h"
+
+namespace concore2full::stack {
+
+stack_resource& default_stack_resource() noexcept {
+  // Never destroyed, as coroutines may finish after the static objects are destroyed.
+  static stack_resource* instance = new size_class_stack_resource();
+  return *instance;
+}
+
+} // namespace concore2full::stack
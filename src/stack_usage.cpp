@@ -0,0 +1,107 @@
+#include "concore2full/stack/stack_usage.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <mutex>
+
+namespace concore2full::stack {
+
+namespace {
+
+//! The pattern used to paint the stacks.
+constexpr uint64_t paint_pattern = 0xC0DEC0DEC0DEC0DEull;
+
+//! Protects the registry of sites.
+std::mutex& registry_bottleneck() {
+  static std::mutex instance;
+  return instance;
+}
+
+} // namespace
+
+stack_site* stack_site::first_{nullptr};
+
+void stack_site::lock_registry() noexcept { registry_bottleneck().lock(); }
+void stack_site::unlock_registry() noexcept { registry_bottleneck().unlock(); }
+
+stack_site::stack_site(const char* name, std::source_location location) noexcept
+    : name_(name ? name : location.function_name()), location_(location) {
+  std::lock_guard<std::mutex> lock{registry_bottleneck()};
+  next_ = first_;
+  if (first_)
+    first_->prev_ = this;
+  first_ = this;
+}
+
+stack_site::~stack_site() {
+  std::lock_guard<std::mutex> lock{registry_bottleneck()};
+  if (prev_)
+    prev_->next_ = next_;
+  else
+    first_ = next_;
+  if (next_)
+    next_->prev_ = prev_;
+}
+
+void stack_site::record(std::size_t bytes) noexcept {
+  samples_.fetch_add(1, std::memory_order_relaxed);
+  std::size_t old_max = max_usage_.load(std::memory_order_relaxed);
+  while (bytes > old_max &&
+         !max_usage_.compare_exchange_weak(old_max, bytes, std::memory_order_relaxed))
+    ;
+  int index = 0;
+  for (std::size_t limit = first_bucket_limit; bytes > limit && index < bucket_count - 1;
+       limit *= 2)
+    index++;
+  buckets_[index].fetch_add(1, std::memory_order_relaxed);
+}
+
+std::size_t stack_site::recommended_size(std::size_t fallback) const noexcept {
+  std::size_t size = size_.load(std::memory_order_relaxed);
+  if (size > 0)
+    return size;
+  if (samples() == 0)
+    return fallback;
+  // Leave a safety margin for the paths that were not exercised while measuring.
+  constexpr std::size_t page = 4 * 1024;
+  size = (2 * max_usage() + page - 1) / page * page;
+  return std::max(size, min_recommended_size);
+}
+
+void report_stack_usage(std::FILE* out) {
+  stack_site::for_each([out](const stack_site& site) {
+    std::fprintf(out, "%s (%s:%u): %" PRIu64 " stacks, max usage %zu bytes, recommended size %zu\n",
+                 site.name(), site.location().file_name(), unsigned(site.location().line()),
+                 site.samples(), site.max_usage(),
+                 site.recommended_size(simple_stack_allocator::default_size_));
+    std::size_t limit = stack_site::first_bucket_limit;
+    for (int i = 0; i < stack_site::bucket_count; i++, limit *= 2) {
+      if (site.bucket(i) == 0)
+        continue;
+      // The last bucket contains all the larger values.
+      const char* op = i + 1 < stack_site::bucket_count ? "<=" : "> ";
+      std::size_t shown = i + 1 < stack_site::bucket_count ? limit : limit / 2;
+      std::fprintf(out, "  %s %zu: %" PRIu64 "\n", op, shown, site.bucket(i));
+    }
+  });
+}
+
+namespace detail {
+
+void paint_stack(stack_t stack) noexcept {
+  auto* end = static_cast<uint64_t*>(stack.sp);
+  auto* begin = end - stack.size / sizeof(uint64_t);
+  std::fill(begin, end, paint_pattern);
+}
+
+std::size_t measure_stack_usage(stack_t stack) noexcept {
+  // The stack grows downwards; find the lowest location that was overwritten.
+  auto* end = static_cast<uint64_t*>(stack.sp);
+  auto* begin = end - stack.size / sizeof(uint64_t);
+  auto* p = std::find_if(begin, end, [](uint64_t v) { return v != paint_pattern; });
+  return std::size_t(end - p) * sizeof(uint64_t);
+}
+
+} // namespace detail
+
+} // namespace concore2full::stack
@@ -1,7 +1,9 @@
 #include "thread_info.h"
 #include <concore2full/detail/atomic_wait.h>
+#include <concore2full/current_thread_pool.h>
 #include <concore2full/detail/callcc.h>
 #include <concore2full/global_thread_pool.h>
+#include <concore2full/thread_pool.h>
 
 #include <cassert>
 #include <mutex>
@@ -145,10 +147,20 @@ continuation_t wait_for_continuation(thread_info* thread) {
   return r;
 }
 
+//! Returns the resource for the stacks used to switch threads: the one of the thread pool of the
+//! current control flow, if there is one, or the default one.
+stack::stack_resource& switch_stacks() {
+  thread_pool* pool = current_thread_pool_override();
+  return pool ? pool->stack_resource() : stack::default_stack_resource();
+}
+
 void requested_switch_with(thread_info* target) {
   profiling::zone zone{CURRENT_LOCATION()};
+  // Our control flow will continue on a different OS thread; keep its current thread pool.
+  preserve_current_thread_pool preserve_pool;
   // The switch data will be stored on the first thread.
-  (void)detail::callcc([target](detail::continuation_t c) -> detail::continuation_t {
+  auto& stacks = switch_stacks();
+  (void)callcc(stacks, switch_stack_class, [target](continuation_t c) -> continuation_t {
     auto* current = &get_current_thread_info();
     assert(current != target);
 
@@ -225,13 +237,17 @@ void switch_to(thread_info* target) {
   if (current == target) {
     return;
   }
+  // Our control flow will continue on a different OS thread; keep its current thread pool.
+  preserve_current_thread_pool preserve_pool;
   zone.set_param("current,x", current);
   zone.set_param("target,x", target);
 
   std::atomic<bool> done{false};
 
   // If we are here, we are just starting the switch.
+  auto& stacks = switch_stacks();
   (void)detail::callcc(
+      stacks, switch_stack_class,
       [current, target, &done](detail::continuation_t c) -> detail::continuation_t {
         // Start waking up the other thread; make sure the continuation is set.
         target->switching_to_.store(c, std::memory_order_relaxed);
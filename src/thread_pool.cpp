@@ -1,4 +1,5 @@
 #include "concore2full/thread_pool.h"
+#include "concore2full/current_thread_pool.h"
 #include "concore2full/detail/sleep_helper.h"
 #include "concore2full/profiling.h"
 #include "concore2full/this_thread.h"
@@ -43,7 +44,11 @@ size_t concurrency() {
 
 thread_pool::thread_pool() : thread_pool(concurrency()) {}
 
-thread_pool::thread_pool(int thread_count) : work_lines_(thread_count + 1) {
+thread_pool::thread_pool(int thread_count)
+    : thread_pool(thread_count, stack::default_stack_resource()) {}
+
+thread_pool::thread_pool(int thread_count, stack::stack_resource& stacks)
+    : work_lines_(thread_count + 1), stack_resource_(&stacks) {
   profiling::zone zone{CURRENT_LOCATION()};
   zone.set_param("thread_count", static_cast<int64_t>(thread_count));
   // Create the sleep objects.
@@ -103,6 +108,36 @@ void thread_pool::enqueue(concore2full_task* task) noexcept {
   notify_one(current_index);
 }
 
+void thread_pool::enqueue_on(concore2full_task* task, int work_line) noexcept {
+  profiling::zone zone{CURRENT_LOCATION()};
+  zone.set_param("task,x", reinterpret_cast<uint64_t>(task));
+  zone.set_param("work_line", static_cast<int64_t>(work_line));
+  zone.add_flow(reinterpret_cast<uint64_t>(task));
+
+  task->next_ = nullptr;
+  task->prev_link_ = nullptr;
+
+  uint32_t work_line_count = work_lines_.size();
+  assert(work_line_count > 0);
+  uint32_t index = uint32_t(work_line) % work_line_count;
+  work_lines_[index].push(task);
+  notify_one(index);
+}
+
+void thread_pool::enqueue_list(concore2full_task* first) noexcept {
+  profiling::zone zone{CURRENT_LOCATION()};
+
+  // Note: using uint32_t, as we need to safely wrap around.
+  uint32_t work_line_count = work_lines_.size();
+  assert(work_line_count > 0);
+  uint32_t index = line_to_push_to_.fetch_add(1, std::memory_order_relaxed) % work_line_count;
+
+  // Splice all the tasks in one go, and then wake up the threads to execute them.
+  int count = work_lines_[index].push_list(first);
+  zone.set_param("count", static_cast<int64_t>(count));
+  notify_many(index, count);
+}
+
 bool thread_pool::extract_task(concore2full_task* task) noexcept {
   profiling::zone zone{CURRENT_LOCATION()};
   zone.set_param("task,x", reinterpret_cast<uint64_t>(task));
@@ -145,7 +180,7 @@ void thread_pool::offer_help_until(std::stop_token stop_condition) noexcept {
 
   // Run the loop to execute tasks.
   int index_hint = sleep_object_index;
-  execute_work(stop_condition, index_hint, sleep_object);
+  execute_work(stop_condition, index_hint, -1, sleep_object);
 
   // Return the sleep object
   {
@@ -253,6 +288,19 @@ bool thread_pool::work_line::extract_task(concore2full_task* task) noexcept {
   }
 }
 
+int thread_pool::work_line::push_list(concore2full_task* first) noexcept {
+  std::unique_lock lock{bottleneck_};
+  int count = 0;
+  while (first) {
+    // Read the next pointer before pushing, as pushing overwrites it.
+    auto* next = first->next_;
+    push_unprotected(first);
+    first = next;
+    count++;
+  }
+  return count;
+}
+
 void thread_pool::work_line::push_unprotected(concore2full_task* task) noexcept {
   // Add the task in the front of the list.
   assert(check_list(tasks_stack_, this));
@@ -280,14 +328,20 @@ concore2full_task* thread_pool::work_line::pop_unprotected() noexcept {
   return nullptr;
 }
 
-void thread_pool::notify_one(int work_line_hint) noexcept {
-  int old = num_tasks_.fetch_add(1, std::memory_order_relaxed);
+void thread_pool::notify_one(int work_line_hint) noexcept { notify_many(work_line_hint, 1); }
+
+void thread_pool::notify_many(int work_line_hint, int count) noexcept {
+  int old = num_tasks_.fetch_add(count, std::memory_order_relaxed);
   // Sync: no ordering guarantees needed here.
   if (old <= int(sleep_objects_.size())) {
-    for (auto& t : sleep_objects_) {
-      if (t.try_notify(work_line_hint)) {
+    // Start with the thread owning the work line (the first sleep objects belong to our workers).
+    int woken = 0;
+    int num_sleep_objects = int(sleep_objects_.size());
+    for (int i = 0; i < num_sleep_objects; i++) {
+      if (woken == count)
         return;
-      }
+      if (sleep_objects_[(work_line_hint + i) % num_sleep_objects].try_notify(work_line_hint))
+        woken++;
     }
   }
 }
@@ -305,7 +359,11 @@ void thread_pool::thread_main(int thread_index) noexcept {
   // We need to exit on the same thread.
   thread_snapshot t;
 
-  execute_work(global_shutdown_.get_token(), thread_index, sleep_objects_[thread_index]);
+  // Work spawned from this thread goes to this pool by default.
+  detail::set_current_thread_pool_override(this);
+
+  execute_work(global_shutdown_.get_token(), thread_index, thread_index,
+               sleep_objects_[thread_index]);
 
   // Ensure we finish on the same thread
   t.revert();
@@ -313,8 +371,10 @@ void thread_pool::thread_main(int thread_index) noexcept {
   (void)profiling::zone_instant{CURRENT_LOCATION_N("worker thread end")};
 }
 
-void thread_pool::execute_work(std::stop_token stop_condition, int index_hint,
+void thread_pool::execute_work(std::stop_token stop_condition, int index_hint, int worker_index,
                                thread_sleep_data& sleep_object) noexcept {
+  // The current thread pool of the control flow that executes the loop.
+  auto* flow_pool = detail::current_thread_pool_override();
   int work_line_count = work_lines_.size();
   int work_line_hint = index_hint;
   while (!stop_condition.stop_requested()) {
@@ -351,7 +411,11 @@ void thread_pool::execute_work(std::stop_token stop_condition, int index_hint,
       profiling::zone zone2{CURRENT_LOCATION_N("execute")};
       zone2.set_param("task,x", to_execute);
       zone2.add_flow_terminate(to_execute);
-      to_execute->task_function_(to_execute, line_index);
+      // Work spawned by the task goes to this pool by default.
+      detail::set_current_thread_pool_override(this);
+      to_execute->task_function_(to_execute, worker_index);
+      // We may be on a different OS thread now; restore the pool of our control flow.
+      detail::set_current_thread_pool_override(flow_pool);
       continue;
     }
   }
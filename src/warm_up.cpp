@@ -0,0 +1,109 @@
+#include "concore2full/warm_up.h"
+#include "concore2full/global_thread_pool.h"
+#include "concore2full/profiling.h"
+#include "thread_info.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <latch>
+#include <vector>
+
+namespace concore2full {
+
+namespace {
+
+//! Allocates the stacks described by `options` from `stacks`, touches their memory, and gives them
+//! back; returns the number of stacks. Warming up is best-effort: stops at the first failure.
+int prefault_stacks(stack::stack_resource& stacks, const warm_up_options& options) noexcept {
+  profiling::zone zone{CURRENT_LOCATION()};
+  std::vector<stack::stack_t> allocated;
+  auto add = [&](stack::stack_size_class size_class, int count) {
+    for (int i = 0; i < count; i++) {
+      stack::stack_t s = stacks.allocate(size_class);
+      // The stack grows downwards; touch the part that is used first.
+      std::size_t size = std::min(options.prefault_size, s.size);
+      std::memset(static_cast<char*>(s.sp) - size, 0, size);
+      allocated.push_back(s);
+    }
+  };
+  try {
+    allocated.reserve(options.stacks_per_thread + options.switch_stacks_per_thread);
+    add(options.size_class, options.stacks_per_thread);
+    add(stack::stack_size_class::small, options.switch_stacks_per_thread);
+  } catch (...) {
+  }
+  // Give the stacks back in reverse order, so that the first allocations get the same stacks.
+  for (auto it = allocated.rbegin(); it != allocated.rend(); ++it)
+    stacks.deallocate(*it);
+  return int(allocated.size());
+}
+
+//! Task that warms up the worker that executes it.
+struct warm_up_task : concore2full_task {
+  stack::stack_resource* stacks_;
+  const warm_up_options* options_;
+  //! Keeps the workers busy until all of them picked up a task, so that each worker gets one.
+  std::latch* all_started_;
+  std::latch* all_done_;
+  std::atomic<int>* stack_count_;
+
+  static void execute(concore2full_task* task, int) noexcept {
+    auto* self = static_cast<warm_up_task*>(task);
+    self->all_started_->arrive_and_wait();
+    (void)detail::get_current_thread_info();
+    int count = prefault_stacks(*self->stacks_, *self->options_);
+    self->stack_count_->fetch_add(count, std::memory_order_relaxed);
+    self->all_done_->count_down();
+  }
+};
+
+} // namespace
+
+warm_up_report warm_up(const warm_up_options& options) {
+  auto start = std::chrono::steady_clock::now();
+  // Creating the global thread pool starts the workers.
+  auto& pool = global_thread_pool();
+  auto report = warm_up(pool, options);
+  report.duration = std::chrono::steady_clock::now() - start;
+  return report;
+}
+
+warm_up_report warm_up(thread_pool& pool, const warm_up_options& options) {
+  profiling::zone zone{CURRENT_LOCATION()};
+  auto start = std::chrono::steady_clock::now();
+  auto& stacks = pool.stack_resource();
+  int worker_count = pool.available_parallelism();
+
+  // Warm up each worker with its own task.
+  std::latch all_started{worker_count};
+  std::latch all_done{worker_count};
+  std::atomic<int> stack_count{0};
+  std::vector<warm_up_task> tasks(worker_count);
+  for (int i = 0; i < worker_count; i++) {
+    auto& t = tasks[i];
+    t.task_function_ = &warm_up_task::execute;
+    t.next_ = nullptr;
+    t.stacks_ = &stacks;
+    t.options_ = &options;
+    t.all_started_ = &all_started;
+    t.all_done_ = &all_done;
+    t.stack_count_ = &stack_count;
+    pool.enqueue_on(&t, i);
+  }
+
+  // In the meantime, warm up the calling thread.
+  (void)detail::get_current_thread_info();
+  int own_stacks = prefault_stacks(stacks, options);
+  all_done.wait();
+
+  warm_up_report report;
+  report.duration = std::chrono::steady_clock::now() - start;
+  report.thread_count = worker_count + 1;
+  report.stack_count = own_stacks + stack_count.load(std::memory_order_relaxed);
+  zone.set_param("duration_ns", static_cast<int64_t>(report.duration.count()));
+  zone.set_param("stack_count", static_cast<int64_t>(report.stack_count));
+  return report;
+}
+
+} // namespace concore2full
@@ -4,6 +4,8 @@
 
 #include <chrono>
 #include <complex>
+#include <cstdio>
+#include <vector>
 
 using namespace std::chrono_literals;
 
@@ -31,6 +33,45 @@ int mandelbrot_core(std::complex<double> c, int depth) {
   return count;
 }
 
+//! Computes the mandelbrot values for the pixels [x_begin, x_end) of line `y`.
+//! Processes a group of pixels at once, in a form that the compiler can vectorize.
+void mandelbrot_line_simd(int* vals, int y, int x_begin, int x_end, int max_x, int depth) {
+  constexpr int lanes = 8;
+  int x = x_begin;
+  for (; x + lanes <= x_end; x += lanes) {
+    double cr[lanes], ci[lanes], zr[lanes], zi[lanes];
+    int counts[lanes];
+    for (int l = 0; l < lanes; l++) {
+      auto c = transform(x + l, y);
+      cr[l] = c.real();
+      ci[l] = c.imag();
+      zr[l] = 0.0;
+      zi[l] = 0.0;
+      counts[l] = 0;
+    }
+    for (int i = 0; i < depth; i++) {
+      int active_lanes = 0;
+      for (int l = 0; l < lanes; l++) {
+        // Once a lane escapes, its value is frozen.
+        bool active = zr[l] * zr[l] + zi[l] * zi[l] < 4.0;
+        double new_zr = zr[l] * zr[l] - zi[l] * zi[l] + cr[l];
+        double new_zi = 2.0 * zr[l] * zi[l] + ci[l];
+        zr[l] = active ? new_zr : zr[l];
+        zi[l] = active ? new_zi : zi[l];
+        counts[l] += active ? 1 : 0;
+        active_lanes += active ? 1 : 0;
+      }
+      if (active_lanes == 0)
+        break;
+    }
+    for (int l = 0; l < lanes; l++)
+      vals[y * max_x + x + l] = counts[l];
+  }
+  // Remaining pixels.
+  for (; x < x_end; x++)
+    vals[y * max_x + x] = mandelbrot_core(transform(x, y), depth);
+}
+
 void serial_mandelbrot(int* vals, int max_x, int max_y, int depth) {
   for (int y = 0; y < max_y; y++) {
     for (int x = 0; x < max_x; x++) {
@@ -47,6 +88,22 @@ void concurrent_mandelbrot(int* vals, int max_x, int max_y, int depth) {
   }).await();
 }
 
+void chunked_mandelbrot(int* vals, int max_x, int max_y, int depth) {
+  concore2full::bulk_spawn_chunked(max_y, [=](int y_begin, int y_end) {
+    for (int y = y_begin; y < y_end; y++) {
+      mandelbrot_line_simd(vals, y, 0, max_x, max_x, depth);
+    }
+  }).await();
+}
+
+void tiled_mandelbrot(int* vals, int max_x, int max_y, int depth) {
+  concore2full::bulk_spawn_2d({max_x, max_y}, {256, 16}, [=](auto begin, auto end) {
+    for (int y = begin[1]; y < end[1]; y++) {
+      mandelbrot_line_simd(vals, y, begin[0], end[0], max_x, depth);
+    }
+  }).await();
+}
+
 TEST_CASE("mandelbrot example", "[benchmark]") {
   std::vector<int> vals(max_x * max_y, 0);
 
@@ -58,6 +115,28 @@ TEST_CASE("mandelbrot example", "[benchmark]") {
   printf("Took %d ms\n", int(duration.count()));
 }
 
+TEST_CASE("mandelbrot example (chunked, SIMD)", "[benchmark]") {
+  std::vector<int> vals(max_x * max_y, 0);
+
+  auto now = std::chrono::high_resolution_clock::now();
+  chunked_mandelbrot(vals.data(), max_x, max_y, depth);
+  auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::high_resolution_clock::now() - now);
+
+  printf("Took %d ms\n", int(duration.count()));
+}
+
+TEST_CASE("mandelbrot example (tiled, SIMD)", "[benchmark]") {
+  std::vector<int> vals(max_x * max_y, 0);
+
+  auto now = std::chrono::high_resolution_clock::now();
+  tiled_mandelbrot(vals.data(), max_x, max_y, depth);
+  auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::high_resolution_clock::now() - now);
+
+  printf("Took %d ms\n", int(duration.count()));
+}
+
 TEST_CASE("mandelbrot example (serial)", "[benchmark]") {
   std::vector<int> vals(max_x * max_y, 0);
 
@@ -2,15 +2,24 @@
 #include "concore2full/profiling.h"
 #include "concore2full/spawn.h"
 #include "concore2full/sync_execute.h"
+#include "concore2full/when_all.h"
 
 #include <catch2/catch_test_macros.hpp>
 
 #include <chrono>
+#include <sys/resource.h>
 #include <inttypes.h>
-#include <numeric>
+#include <functional>
 
 using namespace std::chrono_literals;
 
+//! Returns the number of minor page faults of the process so far.
+long minor_page_faults() {
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_minflt;
+}
+
 uint64_t skynet_strict(int num, int size, int div) {
   // concore2full::profiling::zone zone{CURRENT_LOCATION()};
   // zone.set_param("num", int64_t(num));
@@ -85,7 +94,8 @@ uint64_t skynet_weak(int num, int size, int div) {
       futures.push_back(concore2full::escaping_spawn(skynet_weak_fun{sub_num, sub_size, div}));
     }
 
-    // Wait for the results.
+    // Wait for all the results at once, then collect them.
+    concore2full::when_all(std::span{futures}).await();
     uint64_t sum = 0;
     for (int i = 0; i < div; i++) {
       sum += futures[i].await();
@@ -103,17 +113,16 @@ uint64_t skynet_bulk(int num, int size, int div) {
     // concore2full::profiling::zone z1{CURRENT_LOCATION_N("skynet-1")};
     return uint64_t(num);
   } else {
-    std::vector<uint64_t> results(div);
-
-    // Spawn the sub-tasks, and put the results in the `results` array.
+    // Spawn the sub-tasks, and sum their results.
     const int sub_size = size / div;
-    concore2full::bulk_spawn(div, [=, &results](int i) {
-      int sub_num = num + i * sub_size;
-      results[i] = skynet_bulk(sub_num, sub_size, div);
-    }).await();
-
-    // Get the sum of the results.
-    return std::accumulate(results.begin(), results.end(), uint64_t(0));
+    return concore2full::bulk_reduce(
+               div, uint64_t(0),
+               [=](int i) {
+                 int sub_num = num + i * sub_size;
+                 return skynet_bulk(sub_num, sub_size, div);
+               },
+               std::plus<>{})
+        .await();
   }
 }
 
@@ -121,13 +130,15 @@ TEST_CASE("skynet microbenchmark example", "[benchmark]") {
   concore2full::profiling::emit_thread_name_and_stack("main");
   concore2full::profiling::zone zone{CURRENT_LOCATION()};
 
+  long faults = minor_page_faults();
   auto now = std::chrono::high_resolution_clock::now();
   // uint64_t result = skynet_strict(0, 1'000'000, 10);
   uint64_t result = skynet_strict(0, 10'000, 10);
   auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
       std::chrono::high_resolution_clock::now() - now);
+  faults = minor_page_faults() - faults;
 
-  printf("Result: %" PRIu64 " in %d ms\n", result, int(duration.count()));
+  printf("Result: %" PRIu64 " in %d ms, %ld page faults\n", result, int(duration.count()), faults);
   REQUIRE(result == 49995000);
 }
 
@@ -135,13 +146,15 @@ TEST_CASE("skynet microbenchmark example (weakly structured concurrency)", "[ben
   concore2full::profiling::emit_thread_name_and_stack("main");
   concore2full::profiling::zone zone{CURRENT_LOCATION()};
 
+  long faults = minor_page_faults();
   auto now = std::chrono::high_resolution_clock::now();
   // uint64_t result = skynet_weak(0, 1'000'000, 10);
   uint64_t result = skynet_weak(0, 10'000, 10);
   auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
       std::chrono::high_resolution_clock::now() - now);
+  faults = minor_page_faults() - faults;
 
-  printf("Result: %" PRIu64 " in %d ms\n", result, int(duration.count()));
+  printf("Result: %" PRIu64 " in %d ms, %ld page faults\n", result, int(duration.count()), faults);
   REQUIRE(result == 49995000);
 }
 
@@ -149,12 +162,14 @@ TEST_CASE("skynet microbenchmark example (bulk_spawn)", "[benchmark]") {
   concore2full::profiling::emit_thread_name_and_stack("main");
   concore2full::profiling::zone zone{CURRENT_LOCATION()};
 
+  long faults = minor_page_faults();
   auto now = std::chrono::high_resolution_clock::now();
   // uint64_t result = skynet_bulk(0, 1'000'000, 10);
   uint64_t result = skynet_bulk(0, 10'000, 10);
   auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
       std::chrono::high_resolution_clock::now() - now);
+  faults = minor_page_faults() - faults;
 
-  printf("Result: %" PRIu64 " in %d ms\n", result, int(duration.count()));
+  printf("Result: %" PRIu64 " in %d ms, %ld page faults\n", result, int(duration.count()), faults);
   REQUIRE(result == 49995000);
 }
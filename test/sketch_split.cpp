@@ -56,13 +56,9 @@ TEST_CASE("sketch of implementing a P2300 `split` -- weekly-structured concurren
   printf("resulting document: %s\n", doc.text.c_str());
 }
 
-template <typename Future, typename Fn> auto and_then(Future&& future, Fn&& fn) {
-  auto r = future.await();
-  return concore2full::escaping_spawn([=] { return fn(r); });
-}
-
 TEST_CASE("sketch of implementing a future `and_then`", "[examples]") {
   auto f1 = concore2full::escaping_spawn(create_doc);
-  auto f2 = and_then(f1, apply_gaussian_blur);
+  // The continuation is spawned when `f1` completes; nobody waits on `f1`.
+  auto f2 = f1.then(apply_gaussian_blur);
   save(f2.await());
 }
@@ -0,0 +1,49 @@
+#include "concore2full/bulk_context.h"
+#include "concore2full/sync_execute.h"
+#include "concore2full/thread_pool.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <atomic>
+#include <vector>
+
+TEST_CASE("bulk_context can be used for repeated bulk spawns", "[bulk_spawn]") {
+  // Arrange
+  static constexpr int count = 1000;
+  static constexpr int rounds = 200;
+  std::vector<int> values(count, 0);
+  concore2full::bulk_context ctx;
+
+  // Act
+  for (int r = 0; r < rounds; r++) {
+    ctx.bulk_spawn(count, [&](int64_t i) { values[i]++; }).await();
+  }
+
+  // Assert
+  for (int i = 0; i < count; i++)
+    REQUIRE(values[i] == rounds);
+}
+
+TEST_CASE("bulk_context supports different counts and functions between rounds", "[bulk_spawn]") {
+  // Arrange
+  concore2full::thread_pool pool{4};
+  std::atomic<int64_t> sum{0};
+
+  // Act
+  concore2full::sync_execute([&] {
+    concore2full::bulk_context ctx{pool};
+    for (int64_t count = 1; count <= 100; count++) {
+      ctx.bulk_spawn(count, [&](int64_t i) { sum += i; }).await();
+      ctx.bulk_spawn_chunked(count, 3, [&](int64_t begin, int64_t end) {
+        sum -= (end - begin);
+      }).await();
+    }
+  });
+
+  // Assert
+  // sum over count of: count * (count - 1) / 2 - count
+  int64_t expected = 0;
+  for (int64_t count = 1; count <= 100; count++)
+    expected += count * (count - 1) / 2 - count;
+  REQUIRE(sum.load() == expected);
+}
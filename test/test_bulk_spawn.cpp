@@ -1,10 +1,19 @@
 #include "concore2full/spawn.h"
+#include "concore2full/sync_execute.h"
 
 #include <catch2/catch_test_macros.hpp>
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cstdio>
+#include <functional>
 #include <latch>
+#include <limits>
+#include <stdexcept>
+#include <string>
 #include <thread>
+#include <vector>
 
 using namespace std::chrono_literals;
 
@@ -45,3 +54,463 @@ TEST_CASE("bulk_spawn result can be returned from functions", "[bulk_spawn]") {
   // Assert
   REQUIRE(sum.load() == 45);
 }
+
+TEST_CASE("bulk_spawn_on executes work on the given thread pool", "[bulk_spawn]") {
+  // Arrange
+  static constexpr int count = 4;
+  concore2full::thread_pool pool{2};
+  std::atomic<int> sum{0};
+
+  // Act
+  concore2full::sync_execute([&] {
+    auto f = concore2full::bulk_spawn_on(pool, count, [&](int i) { sum += i; });
+    f.await();
+  });
+
+  // Assert
+  REQUIRE(sum.load() == 6);
+}
+
+TEST_CASE("bulk_spawn executes each index exactly once for large counts", "[bulk_spawn]") {
+  // Arrange
+  static constexpr int count = 100'000;
+  std::vector<std::atomic<int>> executed(count);
+  concore2full::thread_pool pool{4};
+
+  // Act
+  concore2full::sync_execute([&] {
+    auto f = concore2full::bulk_spawn_on(pool, count, [&](int i) { executed[i]++; });
+    f.await();
+  });
+
+  // Assert
+  int executed_once = 0;
+  for (auto& e : executed)
+    executed_once += e.load() == 1 ? 1 : 0;
+  REQUIRE(executed_once == count);
+  // The frame size doesn't depend on the number of work items.
+  using concore2full::detail::bulk_spawn_frame_base;
+  REQUIRE(bulk_spawn_frame_base::frame_size(count, pool) ==
+          bulk_spawn_frame_base::frame_size(1'000'000, pool));
+}
+
+TEST_CASE("the frame size for bulk_spawn from C doesn't depend on the thread pool",
+          "[bulk_spawn]") {
+  using concore2full::detail::bulk_spawn_frame_base;
+  // Arrange
+  concore2full::thread_pool small_pool{1};
+  concore2full::thread_pool large_pool{bulk_spawn_frame_base::max_task_count + 8};
+
+  // Act
+  uint64_t size_small = 0;
+  uint64_t size_large = 0;
+  {
+    concore2full::scoped_thread_pool scoped{small_pool};
+    size_small = concore2full_frame_size(1'000'000);
+  }
+  {
+    concore2full::scoped_thread_pool scoped{large_pool};
+    size_large = concore2full_frame_size(1'000'000);
+  }
+
+  // Assert
+  REQUIRE(size_small == size_large);
+  REQUIRE(size_small >= bulk_spawn_frame_base::frame_size(1'000'000, small_pool));
+  REQUIRE(size_small >= bulk_spawn_frame_base::frame_size(1'000'000, large_pool));
+  REQUIRE(concore2full_frame_size(3) >= bulk_spawn_frame_base::frame_size(3, large_pool));
+  small_pool.join();
+  large_pool.join();
+}
+
+TEST_CASE("bulk_spawn_chunked calls the function with chunks of the given grain",
+          "[bulk_spawn]") {
+  // Arrange
+  static constexpr int count = 10'003;
+  static constexpr int grain = 16;
+  std::vector<std::atomic<int>> executed(count);
+  std::atomic<int> misaligned_chunks{0};
+  concore2full::thread_pool pool{4};
+
+  // Act
+  concore2full::sync_execute([&] {
+    auto f = concore2full::bulk_spawn_chunked_on(pool, count, grain, [&](int begin, int end) {
+      if (begin % grain != 0 || (end - begin != grain && end != count))
+        misaligned_chunks++;
+      for (int i = begin; i < end; i++)
+        executed[i]++;
+    });
+    f.await();
+  });
+
+  // Assert
+  int executed_once = 0;
+  for (auto& e : executed)
+    executed_once += e.load() == 1 ? 1 : 0;
+  REQUIRE(executed_once == count);
+  REQUIRE(misaligned_chunks.load() == 0);
+}
+
+TEST_CASE("bulk_spawn_chunked with automatic grain executes each index exactly once",
+          "[bulk_spawn]") {
+  // Arrange
+  static constexpr int count = 100'000;
+  std::vector<std::atomic<int>> executed(count);
+
+  // Act
+  concore2full::bulk_spawn_chunked(count, [&](int begin, int end) {
+    for (int i = begin; i < end; i++)
+      executed[i]++;
+  }).await();
+
+  // Assert
+  int executed_once = 0;
+  for (auto& e : executed)
+    executed_once += e.load() == 1 ? 1 : 0;
+  REQUIRE(executed_once == count);
+}
+
+TEST_CASE("bulk_spawn_2d covers the index box with tiles", "[bulk_spawn]") {
+  // Arrange
+  static constexpr int size_x = 100;
+  static constexpr int size_y = 37;
+  std::vector<std::atomic<int>> executed(size_x * size_y);
+  std::atomic<int> oversized_tiles{0};
+
+  // Act
+  concore2full::bulk_spawn_2d({size_x, size_y}, {8, 4}, [&](auto begin, auto end) {
+    if (end[0] - begin[0] > 8 || end[1] - begin[1] > 4)
+      oversized_tiles++;
+    for (int y = begin[1]; y < end[1]; y++)
+      for (int x = begin[0]; x < end[0]; x++)
+        executed[y * size_x + x]++;
+  }).await();
+
+  // Assert
+  int executed_once = 0;
+  for (auto& e : executed)
+    executed_once += e.load() == 1 ? 1 : 0;
+  REQUIRE(executed_once == size_x * size_y);
+  REQUIRE(oversized_tiles.load() == 0);
+}
+
+TEST_CASE("bulk_spawn_3d covers the index box with tiles", "[bulk_spawn]") {
+  // Arrange
+  static constexpr int size_x = 10;
+  static constexpr int size_y = 20;
+  static constexpr int size_z = 7;
+  std::vector<std::atomic<int>> executed(size_x * size_y * size_z);
+
+  // Act
+  concore2full::bulk_spawn_3d({size_x, size_y, size_z}, {4, 4, 2}, [&](auto begin, auto end) {
+    for (int z = begin[2]; z < end[2]; z++)
+      for (int y = begin[1]; y < end[1]; y++)
+        for (int x = begin[0]; x < end[0]; x++)
+          executed[(z * size_y + y) * size_x + x]++;
+  }).await();
+
+  // Assert
+  int executed_once = 0;
+  for (auto& e : executed)
+    executed_once += e.load() == 1 ? 1 : 0;
+  REQUIRE(executed_once == size_x * size_y * size_z);
+}
+
+TEST_CASE("bulk_spawn_3d uses row-major order when Morton codes would be mostly padding",
+          "[bulk_spawn]") {
+  // Arrange
+  static constexpr int size = 17;
+  std::vector<std::atomic<int>> executed(size * size * size);
+  // 17 tiles per dimension need 2^15 Morton codes for 17^3 tiles.
+  concore2full::detail::tiled_range<3> range{{size, size, size}, {1, 1, 1}};
+
+  // Act
+  concore2full::bulk_spawn_3d({size, size, size}, {1, 1, 1}, [&](auto begin, auto end) {
+    for (int z = begin[2]; z < end[2]; z++)
+      for (int y = begin[1]; y < end[1]; y++)
+        for (int x = begin[0]; x < end[0]; x++)
+          executed[(z * size + y) * size + x]++;
+  }).await();
+
+  // Assert
+  REQUIRE(range.code_count() == size * size * size);
+  int executed_once = 0;
+  for (auto& e : executed)
+    executed_once += e.load() == 1 ? 1 : 0;
+  REQUIRE(executed_once == size * size * size);
+}
+
+TEST_CASE("tiled_range keeps the Morton order when the padding is limited", "[bulk_spawn]") {
+  // 16 x 135 tiles; 2^12 codes.
+  concore2full::detail::tiled_range<2> range{{4096, 2160}, {256, 16}};
+  REQUIRE(range.morton_);
+  REQUIRE(range.code_count() == 4096);
+}
+
+TEST_CASE("bulk_spawn_2d throws if there are too many tiles", "[bulk_spawn]") {
+  static constexpr int max_int = std::numeric_limits<int>::max();
+  auto f = [](auto, auto) {};
+  REQUIRE_THROWS_AS(concore2full::bulk_spawn_2d({max_int, max_int}, {1, 1}, f), std::length_error);
+}
+
+TEST_CASE("bulk_spawn_2d throws if a tile size is not positive", "[bulk_spawn]") {
+  auto f = [](auto, auto) {};
+  REQUIRE_THROWS_AS(concore2full::bulk_spawn_2d({16, 16}, {0, 4}, f), std::invalid_argument);
+  REQUIRE_THROWS_AS(concore2full::bulk_spawn_2d({16, 16}, {4, -1}, f), std::invalid_argument);
+  REQUIRE_THROWS_AS(concore2full::bulk_spawn_2d({-1, 16}, {4, 4}, f), std::invalid_argument);
+}
+
+TEST_CASE("bulk_spawn_3d over an empty index box doesn't call the function", "[bulk_spawn]") {
+  std::atomic<int> calls{0};
+  auto f = [&](auto, auto) { calls++; };
+  concore2full::bulk_spawn_3d({16, 0, 16}, {4, 4, 4}, f).await();
+  concore2full::bulk_spawn_3d({0, 0, 0}, {1, 1, 1}, f).await();
+  REQUIRE(calls.load() == 0);
+}
+
+TEST_CASE("bulk_reduce combines the values for all indices", "[bulk_spawn]") {
+  // Arrange
+  static constexpr int count = 100'000;
+  concore2full::thread_pool pool{4};
+  uint64_t result{0};
+
+  // Act
+  concore2full::sync_execute([&] {
+    auto f = concore2full::bulk_reduce_on(
+        pool, count, uint64_t(0), [](int i) { return uint64_t(i); }, std::plus<>{});
+    result = f.await();
+  });
+
+  // Assert
+  REQUIRE(result == uint64_t(count) * (count - 1) / 2);
+}
+
+TEST_CASE("bulk_reduce works with fewer indices than workers", "[bulk_spawn]") {
+  // Act
+  auto max_value = concore2full::bulk_reduce(
+                       2, std::string{}, [](int i) { return std::string(i + 1, 'x'); },
+                       [](std::string a, std::string b) { return a.size() > b.size() ? a : b; })
+                       .await();
+  auto single =
+      concore2full::bulk_reduce(1, 10, [](int i) { return i + 3; }, std::plus<>{}).await();
+
+  // Assert
+  REQUIRE(max_value == "xx");
+  REQUIRE(single == 13);
+}
+
+TEST_CASE("bulk_spawn_chunked supports more than 2^31 indices", "[bulk_spawn]") {
+  // Arrange
+  static constexpr int64_t count = (int64_t(3) << 31) + 5;
+  static constexpr int64_t grain = int64_t(1) << 26;
+  std::atomic<int64_t> covered{0};
+  std::atomic<int64_t> max_end{0};
+
+  // Act
+  concore2full::bulk_spawn_chunked(count, grain, [&](int64_t begin, int64_t end) {
+    covered += end - begin;
+    int64_t prev = max_end.load();
+    while (prev < end && !max_end.compare_exchange_weak(prev, end))
+      ;
+  }).await();
+
+  // Assert
+  REQUIRE(covered.load() == count);
+  REQUIRE(max_end.load() == count);
+}
+
+TEST_CASE("bulk_iterate executes the steps of each iteration after the previous iteration",
+          "[bulk_spawn]") {
+  // Arrange
+  static constexpr int count = 1000;
+  static constexpr int iterations = 50;
+  std::vector<std::atomic<int>> last_iteration(count);
+  for (auto& v : last_iteration)
+    v = -1;
+  std::atomic<int> out_of_order{0};
+  concore2full::thread_pool pool{4};
+
+  // Act
+  concore2full::sync_execute([&] {
+    auto f = concore2full::bulk_iterate_on(pool, count, iterations, [&](int64_t it, int64_t i) {
+      // All the indices need to be at the previous iteration, or at this one.
+      int neighbour = last_iteration[(i + 1) % count].load();
+      if (neighbour < it - 1 || neighbour > it)
+        out_of_order++;
+      if (last_iteration[i].exchange(int(it)) != it - 1)
+        out_of_order++;
+    });
+    f.await();
+  });
+
+  // Assert
+  REQUIRE(out_of_order.load() == 0);
+  for (auto& v : last_iteration)
+    REQUIRE(v.load() == iterations - 1);
+}
+
+TEST_CASE("bulk_spawn with an affinity_partitioner executes all the work", "[bulk_spawn]") {
+  // Arrange
+  static constexpr int count = 10'000;
+  static constexpr int rounds = 20;
+  std::vector<int> values(count, 0);
+  concore2full::thread_pool pool{4};
+  concore2full::affinity_partitioner partitioner;
+
+  // Act
+  concore2full::sync_execute([&] {
+    for (int r = 0; r < rounds; r++) {
+      concore2full::bulk_spawn_on(pool, count, [&](int64_t i) { values[i]++; }, partitioner)
+          .await();
+    }
+  });
+
+  // Assert
+  for (int i = 0; i < count; i++)
+    REQUIRE(values[i] == rounds);
+  // The partitioner recorded the work lines for the tasks; the pool has one work line more than
+  // the number of workers.
+  int32_t* lines = partitioner.worker_lines(pool.available_parallelism() + 1);
+  for (int i = 0; i < pool.available_parallelism() + 1; i++) {
+    REQUIRE(lines[i] >= -1);
+    REQUIRE(lines[i] <= pool.available_parallelism());
+  }
+}
+
+TEST_CASE("bulk_spawn with an affinity_partitioner replays the recorded workers", "[bulk_spawn]") {
+  // Arrange
+  static constexpr int workers = 4;
+  concore2full::thread_pool pool{workers};
+  concore2full::affinity_partitioner partitioner;
+  // One index per task; each task blocks until all of them are started, so that each worker
+  // executes exactly one task, and the awaiting thread doesn't execute any.
+  auto run = [&] {
+    std::latch all_started{workers};
+    std::atomic<int> started{0};
+    auto f = concore2full::bulk_spawn_on(
+        pool, workers,
+        [&](int64_t) {
+          started++;
+          all_started.arrive_and_wait();
+        },
+        partitioner);
+    while (started.load() < workers)
+      std::this_thread::yield();
+    f.await();
+    // Let the workers go to sleep.
+    std::this_thread::sleep_for(10ms);
+    int32_t* lines = partitioner.worker_lines(workers);
+    return std::vector<int32_t>(lines, lines + workers);
+  };
+
+  // Act
+  std::vector<int32_t> first;
+  std::vector<int32_t> second;
+  concore2full::sync_execute([&] {
+    first = run();
+    second = run();
+  });
+
+  // Assert
+  std::vector<int32_t> sorted = first;
+  std::sort(sorted.begin(), sorted.end());
+  for (int i = 0; i < workers; i++)
+    REQUIRE(sorted[i] == i);
+  REQUIRE(second == first);
+  pool.join();
+}
+
+TEST_CASE("bulk_spawn_until returns the first index for which the function returns true",
+          "[bulk_spawn]") {
+  // Arrange
+  static constexpr int count = 1'000'000;
+  static constexpr int target = 1'000;
+  std::vector<std::atomic<int>> executed(count);
+  concore2full::thread_pool pool{4};
+
+  // Act
+  int64_t found = concore2full::sync_execute([&] {
+    return concore2full::bulk_spawn_until_on(pool, count,
+                                             [&](int64_t i) {
+                                               executed[i]++;
+                                               return i % target == target - 1;
+                                             })
+        .await();
+  });
+
+  // Assert
+  REQUIRE(found == target - 1);
+  int64_t total = 0;
+  for (int i = 0; i < count; i++) {
+    REQUIRE(executed[i].load() <= 1);
+    if (i <= found)
+      REQUIRE(executed[i].load() == 1);
+    total += executed[i].load();
+  }
+  // The indices after the found one are mostly skipped.
+  REQUIRE(total < count);
+}
+
+TEST_CASE("bulk_spawn_until returns the count if the function never returns true",
+          "[bulk_spawn]") {
+  // Arrange
+  static constexpr int count = 10'000;
+  std::atomic<int> executed{0};
+
+  // Act
+  int64_t found = concore2full::bulk_spawn_until(count, [&](int64_t) {
+                    executed++;
+                    return false;
+                  }).await();
+
+  // Assert
+  REQUIRE(found == count);
+  REQUIRE(executed.load() == count);
+}
+
+TEST_CASE("parallel_find_if finds the first matching element", "[bulk_spawn]") {
+  // Arrange
+  std::vector<int> values(100'000);
+  for (int i = 0; i < int(values.size()); i++)
+    values[i] = i % 1'000;
+
+  // Act
+  auto it = concore2full::parallel_find_if(values.begin(), values.end(),
+                                           [](int x) { return x == 500; });
+  auto missing = concore2full::parallel_find_if(values.begin(), values.end(),
+                                                [](int x) { return x < 0; });
+
+  // Assert
+  REQUIRE(it == values.begin() + 500);
+  REQUIRE(missing == values.end());
+}
+
+TEST_CASE("parallel_find_if is faster than a full scan when the element is found early",
+          "[benchmark]") {
+  // Arrange
+  static constexpr int count = 50'000'000;
+  static constexpr int target = count / 100;
+  std::vector<int> values(count, 0);
+  values[target] = 1;
+  auto pred = [](int x) { return x == 1; };
+
+  // Act
+  auto start = std::chrono::steady_clock::now();
+  auto it = concore2full::parallel_find_if(values.begin(), values.end(), pred);
+  auto duration_find = std::chrono::steady_clock::now() - start;
+
+  start = std::chrono::steady_clock::now();
+  int64_t scanned = concore2full::bulk_reduce(
+                        count, int64_t(count),
+                        [&](int64_t i) { return pred(values[i]) ? i : int64_t(count); },
+                        [](int64_t a, int64_t b) { return std::min(a, b); })
+                        .await();
+  auto duration_scan = std::chrono::steady_clock::now() - start;
+
+  // Assert
+  using std::chrono::microseconds;
+  printf("parallel_find_if: %d us, full scan: %d us\n",
+         int(std::chrono::duration_cast<microseconds>(duration_find).count()),
+         int(std::chrono::duration_cast<microseconds>(duration_scan).count()));
+  REQUIRE(it - values.begin() == target);
+  REQUIRE(scanned == target);
+}
@@ -1,7 +1,11 @@
 #include "concore2full/detail/callcc.h"
+#include "concore2full/spawn.h"
 
 #include <catch2/catch_test_macros.hpp>
 
+#include <chrono>
+#include <cstdio>
+#include <new>
 #include <semaphore>
 #include <thread>
 
@@ -129,3 +133,72 @@ TEST_CASE("can use callcc to switch between threads", "[callcc]") {
   REQUIRE(observed_counter2 == 101);
   REQUIRE(thread_counter == 102);
 }
+
+namespace {
+//! The control structure of `stripped_callcc`, placed at the top of the coroutine stack.
+template <typename F> struct stripped_control {
+  stack::stack_t stack_;
+  F f_;
+};
+
+template <typename F> detail::transfer_t stripped_exit(detail::transfer_t t) noexcept {
+  auto* control = static_cast<stripped_control<F>*>(t.data);
+  stack::stack_t stack = control->stack_;
+  control->~stripped_control<F>();
+  stack::pooled_stack_allocator{}.deallocate(stack);
+  return {nullptr, nullptr};
+}
+
+template <typename F> void stripped_entry(detail::transfer_t t) noexcept {
+  auto* control = static_cast<stripped_control<F>*>(t.data);
+  t.fctx = control->f_(t.fctx);
+  context_core_api_ontop_fcontext(t.fctx, control, stripped_exit<F>);
+}
+
+//! Hand-stripped version of `callcc`, without any instrumentation; the baseline for the benchmark.
+template <typename F> continuation_t stripped_callcc(F f) {
+  stack::stack_t stack = stack::pooled_stack_allocator{}.allocate();
+  constexpr std::size_t reserved = (sizeof(stripped_control<F>) + 63) / 64 * 64;
+  void* top = static_cast<char*>(stack.sp) - reserved;
+  auto* control = new (top) stripped_control<F>{stack, std::move(f)};
+  auto ctx = context_core_api_make_fcontext(top, stack.size - reserved, stripped_entry<F>);
+  return context_core_api_jump_fcontext(ctx, control).fctx;
+}
+
+//! Returns the average duration of `f`, in nanoseconds, over `count` calls.
+template <typename F> double ns_per_op(int count, F&& f) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < count; i++)
+    f();
+  std::chrono::duration<double, std::nano> d = std::chrono::steady_clock::now() - start;
+  return d.count() / count;
+}
+} // namespace
+
+TEST_CASE("callcc costs, compared to hand-stripped code, and spawn/await costs", "[benchmark]") {
+  // With `CONCORE2FULL_INSTRUMENTATION_LEVEL` set to off, `callcc` should cost the same as the
+  // hand-stripped version. There is no hand-stripped spawn/await (it would need its own thread
+  // pool); its cost is only meant to be compared between instrumentation levels.
+  constexpr int count = 100'000;
+  int calls = 0;
+  auto body = [&calls](continuation_t c) {
+    calls++;
+    return c;
+  };
+
+  // Warm up the stack pool and the caches.
+  for (int i = 0; i < 1000; i++) {
+    (void)callcc(body);
+    (void)stripped_callcc(body);
+  }
+  double stripped = ns_per_op(count, [&] { (void)stripped_callcc(body); });
+  double library = ns_per_op(count, [&] { (void)callcc(body); });
+  double spawn_await = ns_per_op(count, [&] {
+    auto f = concore2full::spawn([] { return 1; });
+    calls += f.await();
+  });
+
+  printf("instrumentation level %d: callcc %.1f ns (hand-stripped %.1f ns), spawn/await %.1f ns\n",
+         CONCORE2FULL_INSTRUMENTATION_LEVEL, library, stripped, spawn_await);
+  REQUIRE(calls == 2000 + 3 * count);
+}
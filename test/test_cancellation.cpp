@@ -0,0 +1,86 @@
+#include "concore2full/profiling.h"
+#include "concore2full/spawn.h"
+#include "concore2full/stop_token.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <semaphore>
+
+using namespace std::chrono_literals;
+
+TEST_CASE("stop_source propagates stop requests to child sources", "[cancellation]") {
+  // Arrange
+  concore2full::stop_source parent;
+  concore2full::stop_source child{parent.get_token()};
+  concore2full::stop_source grandchild{child.get_token()};
+  concore2full::stop_token empty_token;
+
+  // Act
+  child.request_stop();
+
+  // Assert
+  REQUIRE_FALSE(parent.stop_requested());
+  REQUIRE(child.get_token().stop_requested());
+  REQUIRE(grandchild.get_token().stop_requested());
+  REQUIRE_FALSE(empty_token.stop_possible());
+  REQUIRE_FALSE(empty_token.stop_requested());
+}
+
+TEST_CASE("spawn with a stopped token doesn't execute the work", "[cancellation]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  std::atomic<int> counter{0};
+  concore2full::stop_source source;
+  source.request_stop();
+
+  // Act
+  auto f1 = concore2full::spawn(source.get_token(), [&] { counter++; });
+  auto f2 = concore2full::escaping_spawn(source.get_token(), [&]() -> int { return ++counter; });
+
+  // Assert
+  REQUIRE_THROWS_AS(f1.await(), concore2full::operation_cancelled);
+  REQUIRE_THROWS_AS(f2.await(), concore2full::operation_cancelled);
+  REQUIRE(counter.load() == 0);
+}
+
+TEST_CASE("spawn with a token that is not stopped executes the work", "[cancellation]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  concore2full::stop_source source;
+
+  // Act
+  auto f = concore2full::spawn(source.get_token(), []() -> int { return 13; });
+
+  // Assert
+  REQUIRE(f.await() == 13);
+}
+
+TEST_CASE("running work can poll the stop token", "[cancellation]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  std::binary_semaphore started{0};
+  concore2full::stop_source source;
+  constexpr auto time_limit = 10s;
+  auto f = concore2full::spawn(source.get_token(), [&, token = source.get_token()]() -> bool {
+    started.release();
+    // Work until a stop is requested, but not more than `time_limit`.
+    auto start = std::chrono::steady_clock::now();
+    while (std::chrono::steady_clock::now() - start < time_limit) {
+      if (token.stop_requested())
+        return true;
+    }
+    return false;
+  });
+  started.acquire();
+
+  // Act
+  auto stop_time = std::chrono::steady_clock::now();
+  source.request_stop();
+  bool saw_stop = f.await();
+
+  // Assert
+  REQUIRE(saw_stop);
+  REQUIRE(std::chrono::steady_clock::now() - stop_time < time_limit);
+}
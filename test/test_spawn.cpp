@@ -2,12 +2,15 @@
 #include "concore2full/profiling.h"
 #include "concore2full/spawn.h"
 #include "concore2full/sync_execute.h"
+#include "concore2full/when_all.h"
 
 #include <catch2/catch_test_macros.hpp>
 
 #include <chrono>
 #include <latch>
 #include <semaphore>
+#include <thread>
+#include <vector>
 
 using namespace std::chrono_literals;
 
@@ -307,3 +310,173 @@ TEST_CASE("copyable_spawn: multiple awaits start before the task", "[spawn]") {
   REQUIRE(res2 == 13);
   REQUIRE(res3 == 13);
 }
+
+TEST_CASE("then executes the continuation after the computation completes", "[spawn]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  std::binary_semaphore can_finish{0};
+  auto f1 = concore2full::escaping_spawn([&]() -> int {
+    can_finish.acquire();
+    return 13;
+  });
+
+  // Act
+  auto f2 = f1.then([](int x) { return x * 2; });
+  auto f3 = f2.then([](int x) { return x + 1; });
+  can_finish.release();
+
+  // Assert
+  REQUIRE(f3.await() == 27);
+}
+
+TEST_CASE("then on a completed computation spawns the continuation directly", "[spawn]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  auto f1 = concore2full::copyable_spawn([]() -> int { return 13; });
+  auto f1_copy = f1;
+  REQUIRE(f1_copy.await() == 13);
+
+  // Act
+  auto f2 = f1.then([](int x) { return x + 1; });
+
+  // Assert
+  REQUIRE(f2.await() == 14);
+}
+
+TEST_CASE("then works with void results", "[spawn]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  std::atomic<int> counter{0};
+  auto f1 = concore2full::escaping_spawn([&] { counter++; });
+
+  // Act
+  auto f2 = f1.then([&]() -> int { return ++counter; });
+
+  // Assert
+  REQUIRE(f2.await() == 2);
+}
+
+TEST_CASE("chained continuations run without being awaited", "[spawn]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  std::binary_semaphore can_finish{0};
+  std::atomic<bool> last_done{false};
+  auto f1 = concore2full::escaping_spawn([&]() -> int {
+    can_finish.acquire();
+    return 13;
+  });
+  auto f2 = f1.then([](int x) { return x * 2; });
+  auto f3 = f2.then([&](int x) {
+    last_done = true;
+    return x + 1;
+  });
+
+  // Act
+  can_finish.release();
+  auto start = std::chrono::steady_clock::now();
+  while (!last_done.load() && std::chrono::steady_clock::now() - start < 5s)
+    std::this_thread::yield();
+
+  // Assert
+  REQUIRE(last_done.load());
+  REQUIRE(f3.await() == 27);
+}
+
+TEST_CASE("when_all can wait for continuations, after the base work completed", "[spawn]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  std::binary_semaphore can_finish{0};
+  auto f1 = concore2full::copyable_spawn([&]() -> int {
+    can_finish.acquire();
+    return 13;
+  });
+  auto f1_copy = f1;
+  auto f2 = f1.then([](int x) { return x + 1; });
+  auto f3 = f1.then([](int x) { return x + 2; });
+  auto all = concore2full::when_all(f2, f3);
+
+  // Act
+  can_finish.release();
+  REQUIRE(f1_copy.await() == 13);
+  all.await();
+
+  // Assert
+  REQUIRE(f2.await() == 14);
+  REQUIRE(f3.await() == 15);
+}
+
+TEST_CASE("spawn_on executes work on the given thread pool", "[spawn]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  concore2full::thread_pool pool{2};
+  concore2full::thread_pool* used_pool{nullptr};
+  std::binary_semaphore started{0};
+
+  // Act
+  concore2full::sync_execute([&] {
+    auto f = concore2full::spawn_on(pool, [&]() -> int {
+      used_pool = &concore2full::current_thread_pool();
+      started.release();
+      return 13;
+    });
+    started.acquire();
+    REQUIRE(f.await() == 13);
+  });
+
+  // Assert
+  REQUIRE(used_pool == &pool);
+}
+
+TEST_CASE("scoped_thread_pool changes the pool used by spawn", "[spawn]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  concore2full::thread_pool pool{2};
+  auto* default_pool = &concore2full::current_thread_pool();
+  concore2full::thread_pool* used_pool{nullptr};
+  concore2full::thread_pool* pool_after_await{nullptr};
+
+  // Act
+  concore2full::sync_execute([&] {
+    concore2full::scoped_thread_pool scope{pool};
+    auto f = concore2full::spawn([&] { used_pool = &concore2full::current_thread_pool(); });
+    f.await();
+    // The current pool follows the control flow, even if the await switched threads.
+    pool_after_await = &concore2full::current_thread_pool();
+  });
+
+  // Assert
+  REQUIRE(used_pool == &pool);
+  REQUIRE(pool_after_await == &pool);
+  REQUIRE(&concore2full::current_thread_pool() == default_pool);
+}
+
+template <typename Future> struct await_copy_fun {
+  Future future_;
+  int operator()() { return future_.await(); }
+};
+
+TEST_CASE("copyable_spawn: many late awaiters are all resumed", "[spawn]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  static constexpr int num_awaiters = 50;
+  std::binary_semaphore can_finish{0};
+  auto f = concore2full::copyable_spawn([&]() -> int {
+    can_finish.acquire();
+    return 13;
+  });
+  using awaiter_t = await_copy_fun<decltype(f)>;
+  using future_t = decltype(concore2full::escaping_spawn(awaiter_t{f}));
+  std::vector<future_t> awaiters;
+  awaiters.reserve(num_awaiters);
+
+  // Act
+  for (int i = 0; i < num_awaiters; i++)
+    awaiters.push_back(concore2full::escaping_spawn(awaiter_t{f}));
+  can_finish.release();
+  int sum = f.await();
+  for (auto& a : awaiters)
+    sum += a.await();
+
+  // Assert
+  REQUIRE(sum == 13 * (num_awaiters + 1));
+}
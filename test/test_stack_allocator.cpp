@@ -1,16 +1,55 @@
+#include "concore2full/detail/callcc.h"
+#include "concore2full/spawn.h"
+#include "concore2full/stack/copying_stack_allocator.h"
+#include "concore2full/stack/huge_page_stack_allocator.h"
+#include "concore2full/stack/mmap_stack_allocator.h"
+#include "concore2full/stack/pooled_stack_allocator.h"
 #include "concore2full/stack/simple_stack_allocator.h"
+#include "concore2full/stack/size_class_stack_resource.h"
+#include "concore2full/stack/stack_resource.h"
+#include "concore2full/stack/stack_usage.h"
 #include "concore2full/stack/stack_allocator.h"
+#include "concore2full/suspend.h"
+#include "concore2full/sync_execute.h"
 
 #include <catch2/catch_test_macros.hpp>
 
+#include <sys/mman.h>
+#include <unistd.h>
+
 #include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 #include <memory>
+#include <thread>
+#include <type_traits>
+#include <vector>
 
 using namespace concore2full;
 
 TEST_CASE("simple_stack_allocator models stack_allocator", "[stack_allocator]") {
   REQUIRE(stack::stack_allocator<stack::simple_stack_allocator>);
 }
+TEST_CASE("pooled_stack_allocator models stack_allocator", "[stack_allocator]") {
+  REQUIRE(stack::stack_allocator<stack::pooled_stack_allocator>);
+}
+TEST_CASE("mmap_stack_allocator models stack_allocator", "[stack_allocator]") {
+  REQUIRE(stack::stack_allocator<stack::mmap_stack_allocator>);
+  REQUIRE(stack::stack_allocator<stack::basic_pooled_stack_allocator<stack::mmap_stack_allocator>>);
+}
+TEST_CASE("huge_page_stack_allocator models stack_allocator", "[stack_allocator]") {
+  REQUIRE(stack::stack_allocator<stack::huge_page_stack_allocator>);
+}
+TEST_CASE("copying_stack_allocator models stack_allocator", "[stack_allocator]") {
+  REQUIRE(stack::stack_allocator<stack::copying_stack_allocator>);
+}
+TEST_CASE("stack usage allocators model stack_allocator", "[stack_allocator]") {
+  REQUIRE(stack::stack_allocator<stack::profiling_stack_allocator<>>);
+  REQUIRE(stack::stack_allocator<stack::site_sized_stack_allocator<>>);
+}
 TEST_CASE("std::allocator models stack_allocator", "[stack_allocator]") {
   REQUIRE(!stack::stack_allocator<std::allocator<int>>);
 }
@@ -80,3 +119,788 @@ TEST_CASE("simple_stack_allocator allocates custom amount of memory", "[stack_al
   // Destroy
   sut.deallocate(stack);
 }
+
+TEST_CASE("pooled_stack_allocator reuses deallocated stacks", "[stack_allocator]") {
+  // Arrange
+  stack::pooled_stack_allocator sut;
+  auto stack1 = sut.allocate();
+  sut.deallocate(stack1);
+
+  // Act
+  auto stack2 = sut.allocate();
+
+  // Assert
+  REQUIRE(stack2.sp == stack1.sp);
+  REQUIRE(stack2.size == stack::pooled_stack_allocator::default_size_);
+
+  // Destroy
+  sut.deallocate(stack2);
+}
+
+TEST_CASE("pooled_stack_allocator allocates custom amount of memory", "[stack_allocator]") {
+  // Arrange
+  stack::pooled_stack_allocator sut(10);
+
+  // Act
+  auto stack = sut.allocate();
+
+  // Assert
+  REQUIRE(stack.size == 10);
+
+  // Destroy
+  sut.deallocate(stack);
+}
+
+//! Allocates and deallocates stacks with a pooled allocator with its own pool, for each of the
+//! given pool sizes; returns the number of pools that reused the deallocated stack.
+template <std::size_t... Sizes> int use_distinct_pools() {
+  auto use = []<std::size_t Size>(std::integral_constant<std::size_t, Size>) {
+    stack::basic_pooled_stack_allocator<stack::simple_stack_allocator, Size> sut;
+    auto stack1 = sut.allocate();
+    std::memset(static_cast<char*>(stack1.sp) - stack1.size, 0x5a, stack1.size);
+    sut.deallocate(stack1);
+    auto stack2 = sut.allocate();
+    bool reused = stack2.sp == stack1.sp && stack2.size == Size;
+    sut.deallocate(stack2);
+    return reused ? 1 : 0;
+  };
+  return (use(std::integral_constant<std::size_t, Sizes>{}) + ...);
+}
+
+TEST_CASE("pooled_stack_allocator works with more pools than it can cache", "[stack_allocator]") {
+  // Act: more distinct pools than the number of pools with thread caches (8).
+  int reused = use_distinct_pools<8192 + 16, 8192 + 32, 8192 + 48, 8192 + 64, 8192 + 80,
+                                  8192 + 96, 8192 + 112, 8192 + 128, 8192 + 144, 8192 + 160,
+                                  8192 + 176, 8192 + 192>();
+
+  // Assert
+  REQUIRE(reused == 12);
+}
+
+TEST_CASE("pooled_stack_allocator can deallocate stacks on other threads", "[stack_allocator]") {
+  // Arrange
+  static constexpr int count = 100;
+  stack::pooled_stack_allocator sut;
+  std::vector<stack::stack_t> stacks;
+  for (int i = 0; i < count; i++)
+    stacks.push_back(sut.allocate());
+
+  // Act: deallocate on a different thread, then allocate them again on this thread.
+  std::thread t{[&] {
+    for (auto s : stacks)
+      sut.deallocate(s);
+  }};
+  t.join();
+  std::vector<stack::stack_t> stacks2;
+  for (int i = 0; i < count; i++)
+    stacks2.push_back(sut.allocate());
+
+  // Assert
+  for (auto s : stacks2) {
+    REQUIRE(s.sp != nullptr);
+    REQUIRE(s.size == stack::pooled_stack_allocator::default_size_);
+  }
+
+  // Destroy
+  for (auto s : stacks2)
+    sut.deallocate(s);
+}
+
+TEST_CASE("mmap_stack_allocator allocates memory that can be filled", "[stack_allocator]") {
+  // Arrange
+  stack::mmap_stack_allocator sut;
+  constexpr uint8_t fill_value = 0xab;
+
+  // Act: fill the memory with a special value
+  auto stack = sut.allocate();
+  auto end = reinterpret_cast<uint8_t*>(stack.sp);
+  auto start = end - stack.size;
+  std::fill(start, end, fill_value);
+
+  // Assert
+  REQUIRE(stack.size == stack::mmap_stack_allocator::default_size_);
+  auto it = std::find_if(start, end, [](uint8_t v) { return v != fill_value; });
+  REQUIRE(it == end);
+
+  // Destroy
+  sut.deallocate(stack);
+}
+
+TEST_CASE("mmap_stack_allocator rounds the stack size to pages", "[stack_allocator]") {
+  // Arrange
+  stack::mmap_stack_allocator sut(10);
+
+  // Act
+  auto stack = sut.allocate();
+
+  // Assert
+  REQUIRE(stack.size == stack::mmap_stack_allocator::page_size());
+
+  // Destroy
+  sut.deallocate(stack);
+}
+
+TEST_CASE("mmap_stack_allocator commits the stack memory lazily", "[stack_allocator]") {
+  // Arrange
+  stack::mmap_stack_allocator sut;
+  std::size_t page = stack::mmap_stack_allocator::page_size();
+  auto stack = sut.allocate();
+  char* start = static_cast<char*>(stack.sp) - stack.size;
+  std::size_t pages = stack.size / page;
+  auto resident_pages = [&] {
+    std::vector<unsigned char> residency(pages);
+    REQUIRE(mincore(start, stack.size, residency.data()) == 0);
+    return std::count_if(residency.begin(), residency.end(), [](unsigned char r) { return r & 1; });
+  };
+
+  // Act: touch the top two pages of the stack
+  auto before = resident_pages();
+  static_cast<char*>(stack.sp)[-1] = 1;
+  static_cast<char*>(stack.sp)[-1 - int(page)] = 1;
+  auto after = resident_pages();
+
+  // Assert
+  REQUIRE(before == 0);
+  REQUIRE(after == 2);
+
+  // Destroy
+  sut.deallocate(stack);
+}
+
+namespace {
+//! Returns the number of resident pages of `stack`, or -1 on failure.
+long resident_pages(stack::stack_t stack) {
+  std::size_t page = stack::mmap_stack_allocator::page_size();
+  std::vector<unsigned char> residency(stack.size / page);
+  if (mincore(static_cast<char*>(stack.sp) - stack.size, stack.size, residency.data()) != 0)
+    return -1;
+  return std::count_if(residency.begin(), residency.end(), [](unsigned char r) { return r & 1; });
+}
+} // namespace
+
+TEST_CASE("pooled_stack_allocator trims the cold part of idle stacks", "[stack_allocator]") {
+  // Arrange: a stack that was entirely touched
+  using allocator_t = stack::basic_pooled_stack_allocator<stack::mmap_stack_allocator>;
+  allocator_t sut;
+  std::size_t page = stack::mmap_stack_allocator::page_size();
+  auto stack = sut.allocate();
+  std::memset(static_cast<char*>(stack.sp) - stack.size, 1, stack.size);
+  sut.deallocate(stack);
+
+  // Act
+  std::size_t released_not_idle = allocator_t::trim(std::chrono::hours(1));
+  std::size_t released = allocator_t::trim();
+  std::size_t released_again = allocator_t::trim();
+  auto reused = sut.allocate();
+
+  // Assert
+  REQUIRE(released_not_idle == 0);
+  REQUIRE(released >= stack.size - stack::detail::trim_keep_size - page);
+  REQUIRE(released_again == 0);
+  REQUIRE(reused.sp == stack.sp);
+  REQUIRE(resident_pages(reused) >= 0);
+  REQUIRE(resident_pages(reused) <= long(stack::detail::trim_keep_size / page));
+
+  // Destroy
+  sut.deallocate(reused);
+}
+
+TEST_CASE("trim_pooled_stacks trims the stacks cached by other threads", "[stack_allocator]") {
+  // Arrange: a stack that was entirely touched, and cached by another thread
+  using allocator_t = stack::basic_pooled_stack_allocator<stack::mmap_stack_allocator>;
+  std::size_t page = stack::mmap_stack_allocator::page_size();
+  std::atomic<int> phase{0};
+  long resident_after_trim = -1;
+  std::thread other{[&] {
+    allocator_t sut;
+    auto stack = sut.allocate();
+    std::memset(static_cast<char*>(stack.sp) - stack.size, 1, stack.size);
+    sut.deallocate(stack);
+    phase = 1;
+    while (phase.load() != 2)
+      std::this_thread::yield();
+    // The next use of the allocator on this thread trims its cache.
+    auto reused = sut.allocate();
+    resident_after_trim = resident_pages(reused);
+    sut.deallocate(reused);
+  }};
+  while (phase.load() != 1)
+    std::this_thread::yield();
+
+  // Act
+  (void)stack::trim_pooled_stacks();
+  phase = 2;
+  other.join();
+
+  // Assert
+  REQUIRE(resident_after_trim >= 0);
+  REQUIRE(resident_after_trim <= long(stack::detail::trim_keep_size / page));
+}
+
+TEST_CASE("pooled stacks cached by idle thread pool workers can be trimmed", "[stack_allocator]") {
+  // Arrange: a worker touches a stack entirely, caches it, and goes to sleep
+  using allocator_t = stack::basic_pooled_stack_allocator<stack::mmap_stack_allocator>;
+  std::size_t page = stack::mmap_stack_allocator::page_size();
+  concore2full::thread_pool pool{1};
+  struct touch_task : concore2full_task {
+    stack::stack_t stack_{};
+    std::atomic<bool> done_{false};
+    static void execute(concore2full_task* task, int) noexcept {
+      auto* self = static_cast<touch_task*>(task);
+      allocator_t sut;
+      auto stack = sut.allocate();
+      std::memset(static_cast<char*>(stack.sp) - stack.size, 1, stack.size);
+      sut.deallocate(stack);
+      self->stack_ = stack;
+      self->done_.store(true);
+    }
+  };
+  touch_task task;
+  task.task_function_ = &touch_task::execute;
+  task.next_ = nullptr;
+  pool.enqueue(&task);
+  while (!task.done_.load())
+    std::this_thread::yield();
+
+  // Act: the worker never uses the allocator again; trim from this thread
+  long resident = -1;
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (std::chrono::steady_clock::now() < deadline) {
+    (void)allocator_t::trim();
+    resident = resident_pages(task.stack_);
+    if (resident >= 0 && resident <= long(stack::detail::trim_keep_size / page))
+      break;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  pool.join();
+
+  // Assert
+  REQUIRE(resident >= 0);
+  REQUIRE(resident <= long(stack::detail::trim_keep_size / page));
+}
+
+TEST_CASE("pooled mmap stacks can be used to run coroutines", "[stack_allocator]") {
+  // Arrange
+  using allocator_t = stack::basic_pooled_stack_allocator<stack::mmap_stack_allocator>;
+  int called = 0;
+
+  // Act
+  for (int i = 0; i < 100; i++) {
+    (void)detail::callcc(std::allocator_arg, allocator_t{},
+                         [&](detail::continuation_t c) -> detail::continuation_t {
+                           called++;
+                           return c;
+                         });
+  }
+
+  // Assert
+  REQUIRE(called == 100);
+}
+
+TEST_CASE("huge_page_stack_allocator allocates memory that can be filled", "[stack_allocator]") {
+  // Arrange
+  stack::huge_page_stack_allocator sut;
+  constexpr uint8_t fill_value = 0xab;
+
+  // Act: fill the memory with a special value
+  auto stack1 = sut.allocate();
+  auto stack2 = sut.allocate();
+  auto end = reinterpret_cast<uint8_t*>(stack1.sp);
+  auto start = end - stack1.size;
+  std::fill(start, end, fill_value);
+
+  // Assert
+  REQUIRE(stack1.size == stack::huge_page_stack_allocator::default_size_);
+  REQUIRE(stack1.sp != stack2.sp);
+  auto it = std::find_if(start, end, [](uint8_t v) { return v != fill_value; });
+  REQUIRE(it == end);
+
+  // Destroy
+  sut.deallocate(stack1);
+  sut.deallocate(stack2);
+}
+
+TEST_CASE("huge_page_stack_allocator reuses deallocated stacks", "[stack_allocator]") {
+  // Arrange
+  stack::huge_page_stack_allocator sut(100'000);
+  auto stack1 = sut.allocate();
+  sut.deallocate(stack1);
+
+  // Act
+  auto stack2 = sut.allocate();
+
+  // Assert
+  REQUIRE(stack2.sp == stack1.sp);
+  REQUIRE(stack2.size >= 100'000);
+
+  // Destroy
+  sut.deallocate(stack2);
+}
+
+namespace {
+//! Switches between `count` live coroutines, for `rounds` rounds; each coroutine touches some of
+//! its stack memory at each switch. Returns the duration of the switching, in microseconds.
+template <typename A> int64_t measure_coroutine_switches(int count, int rounds) {
+  std::vector<detail::continuation_t> coroutines(count);
+  for (int i = 0; i < count; i++) {
+    coroutines[i] = detail::callcc(
+        std::allocator_arg, A{}, [rounds](detail::continuation_t c) -> detail::continuation_t {
+          volatile char buffer[8 * 1024];
+          for (int r = 0; r <= rounds; r++) {
+            buffer[(r * 64) % sizeof(buffer)] = char(r);
+            c = detail::resume(c);
+          }
+          return c;
+        });
+  }
+  auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < rounds; r++)
+    for (auto& c : coroutines)
+      c = detail::resume(c);
+  auto duration = std::chrono::steady_clock::now() - start;
+  // Let the coroutines finish.
+  for (auto& c : coroutines)
+    (void)detail::resume(c);
+  return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+}
+} // namespace
+
+TEST_CASE("huge page stacks reduce the cost of switching between many coroutines",
+          "[benchmark]") {
+  constexpr int count = 2'000;
+  constexpr int rounds = 200;
+  using pooled_huge_t = stack::basic_pooled_stack_allocator<stack::huge_page_stack_allocator>;
+  using pooled_mmap_t = stack::basic_pooled_stack_allocator<stack::mmap_stack_allocator>;
+
+  auto time_malloc = measure_coroutine_switches<stack::pooled_stack_allocator>(count, rounds);
+  auto time_mmap = measure_coroutine_switches<pooled_mmap_t>(count, rounds);
+  auto time_huge = measure_coroutine_switches<pooled_huge_t>(count, rounds);
+
+  const char* kinds[] = {"normal", "transparent", "explicit"};
+  auto kind = stack::huge_page_stack_allocator::arena_page_kind();
+  printf("%d coroutines x %d switches: malloc %d us, mmap %d us, huge pages (%s) %d us\n", count,
+         rounds, int(time_malloc), int(time_mmap), kinds[int(kind)], int(time_huge));
+}
+
+namespace {
+//! Uses about `depth` KB of stack.
+int use_stack(int depth) {
+  volatile char buffer[1024];
+  buffer[0] = char(depth);
+  if (depth <= 1)
+    return buffer[0];
+  return use_stack(depth - 1) + buffer[0];
+}
+
+//! Runs a coroutine using about `depth` KB of stack, with the allocator `a`.
+void run_coroutine(stack::stack_allocator auto a, int depth) {
+  (void)detail::callcc(std::allocator_arg, a,
+                       [depth](detail::continuation_t c) -> detail::continuation_t {
+                         (void)use_stack(depth);
+                         return c;
+                       });
+}
+} // namespace
+
+TEST_CASE("profiling_stack_allocator measures the stack usage of coroutines", "[stack_allocator]") {
+  // Arrange
+  static stack::stack_site site{"measured coroutine"};
+
+  // Act
+  run_coroutine(stack::profiling_stack_allocator<>{site}, 64);
+  run_coroutine(stack::profiling_stack_allocator<>{site}, 8);
+
+  // Assert
+  REQUIRE(site.samples() == 2);
+  REQUIRE(site.max_usage() >= 64 * 1024);
+  REQUIRE(site.max_usage() < 512 * 1024);
+  uint64_t total = 0;
+  for (int i = 0; i < stack::stack_site::bucket_count; i++)
+    total += site.bucket(i);
+  REQUIRE(total == 2);
+}
+
+TEST_CASE("site_sized_stack_allocator uses the stack size learned for the site",
+          "[stack_allocator]") {
+  // Arrange
+  static stack::stack_site site{"sized coroutine"};
+  stack::site_sized_stack_allocator<> sut{site};
+  auto size_before = sut.allocate();
+  sut.deallocate(size_before);
+
+  // Act
+  run_coroutine(stack::profiling_stack_allocator<>{site}, 32);
+  auto learned = sut.allocate();
+  sut.deallocate(learned);
+  run_coroutine(sut, 32);
+  site.set_size(256 * 1024);
+  auto explicit_size = sut.allocate();
+  sut.deallocate(explicit_size);
+
+  // Assert
+  REQUIRE(size_before.size == stack::mmap_stack_allocator::default_size_);
+  REQUIRE(learned.size >= 2 * site.max_usage());
+  REQUIRE(learned.size * 4 <= stack::mmap_stack_allocator::default_size_);
+  REQUIRE(explicit_size.size == 256 * 1024);
+}
+
+TEST_CASE("site_sized_stack_allocator places a guard page below the learned stacks",
+          "[stack_allocator]") {
+  // Arrange
+  static stack::stack_site site{"guarded coroutine"};
+  site.set_size(16 * 1024);
+  stack::site_sized_stack_allocator<> sut{site};
+
+  // Act
+  auto stack = sut.allocate();
+  std::size_t page = stack::mmap_stack_allocator::page_size();
+  void* guard = static_cast<char*>(stack.sp) - stack.size - page;
+  // The kernel refuses to read from an inaccessible page, instead of crashing us.
+  int fds[2];
+  REQUIRE(pipe(fds) == 0);
+  bool guarded = write(fds[1], guard, 1) == -1 && errno == EFAULT;
+  close(fds[0]);
+  close(fds[1]);
+  sut.deallocate(stack);
+
+  // Assert
+  REQUIRE(stack.size == 16 * 1024);
+  REQUIRE(guarded);
+}
+
+TEST_CASE("report_stack_usage reports the registered sites", "[stack_allocator]") {
+  // Arrange
+  stack::stack_site site{"reported coroutine"};
+  run_coroutine(stack::profiling_stack_allocator<>{site}, 4);
+  std::FILE* out = std::tmpfile();
+  REQUIRE(out != nullptr);
+
+  // Act
+  stack::report_stack_usage(out);
+
+  // Assert
+  std::rewind(out);
+  char line[256];
+  bool found = false;
+  while (std::fgets(line, sizeof(line), out))
+    found = found || std::strstr(line, "reported coroutine") != nullptr;
+  std::fclose(out);
+  REQUIRE(found);
+}
+
+namespace {
+//! A stack resource that counts the stacks it hands out.
+struct counting_stack_resource : stack::stack_resource {
+  std::atomic<int> allocations_{0};
+  std::atomic<int> deallocations_{0};
+
+  stack::stack_t allocate() override {
+    allocations_++;
+    return stack::simple_stack_allocator{}.allocate();
+  }
+  void deallocate(stack::stack_t stack) override {
+    deallocations_++;
+    stack::simple_stack_allocator{}.deallocate(stack);
+  }
+};
+} // namespace
+
+TEST_CASE("stack_resource_adaptor models stack_allocator through resource_stack_allocator",
+          "[stack_allocator]") {
+  // Arrange
+  stack::stack_resource_adaptor<stack::mmap_stack_allocator> resource{64 * 1024};
+  static_assert(stack::stack_allocator<stack::resource_stack_allocator>);
+
+  // Act
+  int result = 0;
+  auto cont = concore2full::detail::callcc(resource, [&](auto c) {
+    result = 13;
+    return c;
+  });
+
+  // Assert
+  REQUIRE(result == 13);
+}
+
+TEST_CASE("thread_pool obtains all the coroutine stacks from its stack resource",
+          "[stack_allocator]") {
+  // Arrange
+  counting_stack_resource resource;
+  {
+    concore2full::thread_pool pool{2, resource};
+    REQUIRE(&pool.stack_resource() == &resource);
+
+    // Act
+    auto f = concore2full::spawn_on(pool, [] { return 17; });
+    REQUIRE(f.await() == 17);
+    std::atomic<int> sum{0};
+    auto g = concore2full::bulk_spawn_on(pool, 100, [&](int64_t i) { sum += int(i); });
+    g.await();
+    REQUIRE(sum.load() == 4950);
+    pool.join();
+  }
+
+  // Assert
+  REQUIRE(resource.allocations_.load() > 0);
+  REQUIRE(resource.allocations_.load() == resource.deallocations_.load());
+}
+
+TEST_CASE("spawn and bulk_spawn can use a given stack resource", "[stack_allocator]") {
+  // Arrange
+  counting_stack_resource resource;
+  std::atomic<int> count{0};
+
+  // Act
+  {
+    // Use a private thread pool, and join it, so that all the stacks are given back before we
+    // count them.
+    concore2full::thread_pool pool{2};
+    concore2full::scoped_thread_pool scoped{pool};
+    auto f = concore2full::spawn(std::allocator_arg, resource, [] { return 19; });
+    REQUIRE(f.await() == 19);
+    auto g = concore2full::bulk_spawn(std::allocator_arg, resource, 10, [&](int64_t) { count++; });
+    g.await();
+    pool.join();
+  }
+
+  // Assert
+  REQUIRE(count.load() == 10);
+  // The spawn may be executed inline by `await`, but the bulk spawn always needs a stack to await.
+  REQUIRE(resource.allocations_.load() >= 1);
+  REQUIRE(resource.allocations_.load() == resource.deallocations_.load());
+}
+
+TEST_CASE("size_class_stack_resource serves each size class from its own pool",
+          "[stack_allocator]") {
+  // Arrange
+  using sut_t = stack::size_class_stack_resource;
+  static_assert(stack::stack_allocator<
+                stack::basic_pooled_stack_allocator<stack::simple_stack_allocator, 64 * 1024>>);
+  sut_t sut;
+
+  // Act
+  auto small = sut.allocate(stack::stack_size_class::small);
+  auto normal = sut.allocate(stack::stack_size_class::normal);
+  auto large = sut.allocate(stack::stack_size_class::large);
+  auto unhinted = sut.allocate();
+
+  // Assert
+  REQUIRE(small.size == sut_t::small_size);
+  REQUIRE(normal.size == sut_t::normal_size);
+  REQUIRE(large.size == sut_t::large_size);
+  REQUIRE(unhinted.size == sut_t::normal_size);
+  std::memset(static_cast<char*>(small.sp) - small.size, 0xAB, small.size);
+  std::memset(static_cast<char*>(large.sp) - large.size, 0xAB, large.size);
+
+  // The stacks go back to the pool of their class.
+  void* small_sp = small.sp;
+  void* large_sp = large.sp;
+  sut.deallocate(small);
+  sut.deallocate(large);
+  REQUIRE(sut.allocate(stack::stack_size_class::large).sp == large_sp);
+  REQUIRE(sut.allocate(stack::stack_size_class::small).sp == small_sp);
+  sut.deallocate({sut_t::small_size, small_sp});
+  sut.deallocate({sut_t::large_size, large_sp});
+  sut.deallocate(normal);
+  sut.deallocate(unhinted);
+}
+
+namespace {
+//! A stack resource that records the size classes of the stacks it hands out.
+struct recording_stack_resource : stack::stack_resource {
+  std::atomic<int> counts_[3]{};
+
+  stack::stack_t allocate() override { return allocate(stack::stack_size_class::normal); }
+  stack::stack_t allocate(stack::stack_size_class size_class) override {
+    counts_[int(size_class)]++;
+    return stack::default_stack_resource().allocate(size_class);
+  }
+  void deallocate(stack::stack_t stack) override {
+    stack::default_stack_resource().deallocate(stack);
+  }
+  int count(stack::stack_size_class size_class) const { return counts_[int(size_class)].load(); }
+};
+} // namespace
+
+TEST_CASE("spawn and bulk_spawn pass the stack size hints to the stack resource",
+          "[stack_allocator]") {
+  // Arrange
+  recording_stack_resource resource;
+  {
+    concore2full::thread_pool pool{2, resource};
+    concore2full::scoped_thread_pool scoped{pool};
+
+    // Act
+    // Keep the spawning thread busy until the work starts, so that it is not executed inline.
+    std::atomic<bool> started{false};
+    auto f = concore2full::spawn(stack::stack_size_class::large, [&] {
+      started = true;
+      return 23;
+    });
+    while (!started.load())
+      std::this_thread::yield();
+    REQUIRE(f.await() == 23);
+    std::atomic<int> count{0};
+    auto g = concore2full::bulk_spawn(stack::stack_size_class::small, 10,
+                                      [&](int64_t) { count++; });
+    g.await();
+    REQUIRE(count.load() == 10);
+    pool.join();
+  }
+
+  // Assert
+  REQUIRE(resource.count(stack::stack_size_class::large) == 1);
+  // The bulk spawn, and the coroutines that switch threads.
+  REQUIRE(resource.count(stack::stack_size_class::small) >= 1);
+}
+
+TEST_CASE("coroutines that help the thread pool while suspended use normal stacks",
+          "[stack_allocator]") {
+  // Arrange
+  recording_stack_resource resource;
+  {
+    concore2full::thread_pool pool{1, resource};
+    concore2full::suspend_token token;
+    std::atomic<bool> suspending{false};
+
+    // Act: the tasks of the pool may run inline on the coroutine that helps the pool
+    std::thread suspended{[&] {
+      concore2full::scoped_thread_pool scoped{pool};
+      concore2full::sync_execute([&] {
+        suspending = true;
+        concore2full::suspend_quick_resume(token);
+      });
+    }};
+    while (!suspending.load())
+      std::this_thread::yield();
+    token.notify();
+    suspended.join();
+    pool.join();
+  }
+
+  // Assert
+  REQUIRE(resource.count(stack::stack_size_class::normal) >= 1);
+}
+
+TEST_CASE("copying_stack_allocator allocates memory that can be filled", "[stack_allocator]") {
+  // Arrange
+  stack::copying_stack_allocator sut{64 * 1024};
+  constexpr uint8_t fill_value = 0xab;
+
+  // Act: fill the memory of two stacks with a special value
+  auto s1 = sut.allocate();
+  auto s2 = sut.allocate();
+  for (auto stack : {s1, s2}) {
+    auto end = reinterpret_cast<uint8_t*>(stack.sp);
+    std::fill(end - stack.size, end, fill_value);
+  }
+
+  // Assert
+  for (auto stack : {s1, s2}) {
+    REQUIRE(stack.size >= 60 * 1024);
+    REQUIRE(stack.size <= 64 * 1024);
+    auto end = reinterpret_cast<uint8_t*>(stack.sp);
+    auto it = std::find_if(end - stack.size, end, [](uint8_t v) { return v != fill_value; });
+    REQUIRE(it == end);
+  }
+  // The tops of the stacks are not aligned the same way.
+  auto alignment = [](stack::stack_t s) { return reinterpret_cast<uintptr_t>(s.sp) % 4096; };
+  REQUIRE(alignment(s1) != alignment(s2));
+
+  // Destroy
+  sut.deallocate(s1);
+  sut.deallocate(s2);
+}
+
+namespace {
+//! Creates a chain of `depth` coroutines, each awaiting the next one, while the next one is
+//! executed by a different thread. The last coroutine stores into `parked` the number of parked
+//! coroutines, after waiting for all the others to be parked.
+int await_chain(stack::stack_resource& stacks, int depth, int total,
+                std::atomic<int64_t>& parked) {
+  if (depth == 0) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (stack::copying_stack_allocator::parked_count() < total &&
+           std::chrono::steady_clock::now() < deadline)
+      std::this_thread::yield();
+    parked = stack::copying_stack_allocator::parked_count();
+    return 0;
+  }
+  auto started = std::make_shared<std::atomic<bool>>(false);
+  auto child = concore2full::escaping_spawn(std::allocator_arg, stacks, [=, &stacks, &parked] {
+    started->store(true);
+    return await_chain(stacks, depth - 1, total, parked) + 1;
+  });
+  // Ensure that the child is started by another thread, so that our `await` needs to park.
+  while (!started->load())
+    std::this_thread::yield();
+  return child.await_parked();
+}
+} // namespace
+
+TEST_CASE("coroutines using copying_stack_allocator release their stacks while parked",
+          "[stack_allocator]") {
+  // Arrange
+  constexpr int depth = 10'000;
+  stack::stack_resource_adaptor<stack::copying_stack_allocator> resource;
+  std::atomic<int64_t> parked{0};
+
+  // Act: the first coroutine runs on the stack of the current thread, so it cannot be parked.
+  int result = await_chain(resource, depth, depth - 1, parked);
+  int64_t parked_bytes = stack::copying_stack_allocator::parked_bytes();
+
+  // Assert
+  REQUIRE(result == depth);
+  REQUIRE(parked.load() == depth - 1);
+  REQUIRE(stack::copying_stack_allocator::parked_count() == 0);
+  REQUIRE(parked_bytes == 0);
+}
+
+TEST_CASE("coroutines using copying_stack_allocator keep their stacks while awaiting",
+          "[stack_allocator]") {
+  // Arrange
+  constexpr int count = 16;
+  stack::stack_resource_adaptor<stack::copying_stack_allocator> resource;
+  concore2full::thread_pool pool{4};
+  concore2full::scoped_thread_pool scoped{pool};
+  // Runs on a copying stack, and shares its locals with the work it awaits.
+  auto body = [] {
+    int value = 0;
+    std::atomic<bool> started{false};
+    auto child = concore2full::escaping_spawn([&] {
+      started = true;
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      value = 42;
+    });
+    // Ensure that the child is started by another thread, so that our `await` needs to wait.
+    while (!started.load())
+      std::this_thread::yield();
+    child.await();
+
+    int values[count]{};
+    concore2full::bulk_spawn(count, [&](int64_t i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+      values[i] = int(i) + 1;
+    }).await();
+    for (int v : values)
+      value += v;
+    return value;
+  };
+
+  // Act: come back to this thread, so that we can join the pool.
+  int result = concore2full::sync_execute([&] {
+    std::atomic<bool> started{false};
+    auto f = concore2full::escaping_spawn(std::allocator_arg, resource, [&] {
+      started = true;
+      return body();
+    });
+    while (!started.load())
+      std::this_thread::yield();
+    return f.await();
+  });
+  pool.join();
+
+  // Assert
+  REQUIRE(result == 42 + count * (count + 1) / 2);
+  REQUIRE(stack::copying_stack_allocator::parked_count() == 0);
+}
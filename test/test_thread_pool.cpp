@@ -1,11 +1,23 @@
+#include "concore2full/global_thread_pool.h"
+#include "concore2full/stack/pooled_stack_allocator.h"
+#include "concore2full/stack/simple_stack_allocator.h"
 #include "concore2full/thread_pool.h"
+#include "concore2full/warm_up.h"
 
 #include <catch2/catch_test_macros.hpp>
 
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <functional>
 #include <latch>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
 
 using namespace std::chrono_literals;
 
@@ -242,3 +254,119 @@ TEST_CASE("thread_pool still functions after a helping thread left the pool", "[
 
   sut.join();
 }
+
+namespace {
+//! A stack resource that records the threads that obtained stacks from it.
+struct thread_recording_stack_resource : concore2full::stack::stack_resource {
+  std::mutex bottleneck_;
+  std::set<std::thread::id> threads_;
+  std::atomic<int> allocations_{0};
+  std::atomic<int> deallocations_{0};
+
+  concore2full::stack::stack_t allocate() override {
+    {
+      std::lock_guard<std::mutex> lock{bottleneck_};
+      threads_.insert(std::this_thread::get_id());
+    }
+    allocations_++;
+    return concore2full::stack::simple_stack_allocator{}.allocate();
+  }
+  void deallocate(concore2full::stack::stack_t stack) override {
+    deallocations_++;
+    concore2full::stack::simple_stack_allocator{}.deallocate(stack);
+  }
+};
+} // namespace
+
+TEST_CASE("warm_up prefaults stacks on all the workers and on the calling thread",
+          "[thread_pool]") {
+  // Arrange
+  thread_recording_stack_resource resource;
+  concore2full::thread_pool sut{3, resource};
+  concore2full::warm_up_options options;
+  options.stacks_per_thread = 2;
+  options.switch_stacks_per_thread = 1;
+
+  // Act
+  auto report = concore2full::warm_up(sut, options);
+
+  // Assert
+  REQUIRE(report.thread_count == 4);
+  REQUIRE(report.stack_count == 4 * 3);
+  REQUIRE(report.duration.count() > 0);
+  REQUIRE(resource.allocations_.load() == 4 * 3);
+  REQUIRE(resource.deallocations_.load() == 4 * 3);
+  REQUIRE(resource.threads_.size() == 4);
+  REQUIRE(resource.threads_.count(std::this_thread::get_id()) == 1);
+  sut.join();
+}
+
+TEST_CASE("warm_up starts the global thread pool", "[thread_pool]") {
+  // Act
+  auto report = concore2full::warm_up();
+
+  // Assert
+  REQUIRE(report.thread_count == concore2full::global_thread_pool().available_parallelism() + 1);
+  REQUIRE(report.stack_count > 0);
+}
+
+namespace {
+//! Records the stacks obtained from the default stack resource.
+struct stack_recording_resource : concore2full::stack::stack_resource {
+  std::mutex bottleneck_;
+  std::vector<concore2full::stack::stack_t> stacks_;
+
+  concore2full::stack::stack_t allocate() override {
+    return allocate(concore2full::stack::stack_size_class::normal);
+  }
+  concore2full::stack::stack_t allocate(concore2full::stack::stack_size_class cls) override {
+    auto stack = concore2full::stack::default_stack_resource().allocate(cls);
+    std::lock_guard<std::mutex> lock{bottleneck_};
+    stacks_.push_back(stack);
+    return stack;
+  }
+  void deallocate(concore2full::stack::stack_t stack) override {
+    concore2full::stack::default_stack_resource().deallocate(stack);
+  }
+};
+
+//! Returns the number of pages in the top `size` bytes of `stack` that are not resident.
+long missing_pages(concore2full::stack::stack_t stack, std::size_t size) {
+  uintptr_t page = uintptr_t(sysconf(_SC_PAGESIZE));
+  uintptr_t top = reinterpret_cast<uintptr_t>(stack.sp);
+  uintptr_t begin = (top - size + page - 1) & ~(page - 1);
+  uintptr_t end = top & ~(page - 1);
+  std::vector<unsigned char> residency((end - begin) / page);
+  REQUIRE(mincore(reinterpret_cast<void*>(begin), end - begin, residency.data()) == 0);
+  auto is_missing = [](unsigned char r) { return (r & 1) == 0; };
+  return long(std::count_if(residency.begin(), residency.end(), is_missing));
+}
+} // namespace
+
+TEST_CASE("stacks prefaulted by warm_up stay resident while the pool is idle", "[thread_pool]") {
+  // Arrange
+  stack_recording_resource resource;
+  concore2full::thread_pool sut{2, resource};
+  concore2full::warm_up_options options;
+  options.stacks_per_thread = 2;
+  options.switch_stacks_per_thread = 1;
+  auto report = concore2full::warm_up(sut, options);
+  REQUIRE(report.stack_count == 3 * 3);
+
+  // Act: stay idle for longer than the automatic trimming threshold of the depots
+  std::this_thread::sleep_for(concore2full::stack::detail::idle_trim_threshold + 500ms);
+  // Use the pools again; taking more stacks than a thread caches makes the depots trim.
+  using concore2full::stack::stack_size_class;
+  std::vector<concore2full::stack::stack_t> used;
+  for (auto size_class : {stack_size_class::normal, stack_size_class::small})
+    for (int i = 0; i < 17; i++)
+      used.push_back(concore2full::stack::default_stack_resource().allocate(size_class));
+  for (auto it = used.rbegin(); it != used.rend(); ++it)
+    concore2full::stack::default_stack_resource().deallocate(*it);
+
+  // Assert
+  REQUIRE(resource.stacks_.size() == 3 * 3);
+  for (auto stack : resource.stacks_)
+    REQUIRE(missing_pages(stack, std::min(options.prefault_size, stack.size)) == 0);
+  sut.join();
+}
@@ -0,0 +1,118 @@
+#include "concore2full/profiling.h"
+#include "concore2full/spawn.h"
+#include "concore2full/when_all.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <chrono>
+#include <semaphore>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+TEST_CASE("when_all waits for all the spawned computations", "[when_all]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  std::atomic<int> counter{0};
+  auto f1 = concore2full::spawn([&]() -> int {
+    counter++;
+    return 1;
+  });
+  auto f2 = concore2full::spawn([&]() -> int {
+    std::this_thread::sleep_for(1ms);
+    counter++;
+    return 2;
+  });
+  auto f3 = concore2full::spawn([&] { counter++; });
+
+  // Act
+  concore2full::when_all(f1, f2, f3).await();
+
+  // Assert
+  REQUIRE(counter.load() == 3);
+  REQUIRE(f1.await() == 1);
+  REQUIRE(f2.await() == 2);
+  f3.await();
+}
+
+struct return_value_fun {
+  int value_;
+  int operator()() const { return value_; }
+};
+
+TEST_CASE("when_all works with a range of escaping_spawn futures", "[when_all]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  using future_t = decltype(concore2full::escaping_spawn(return_value_fun{0}));
+  std::vector<future_t> futures;
+  for (int i = 0; i < 10; i++) {
+    futures.push_back(concore2full::escaping_spawn(return_value_fun{i}));
+  }
+
+  // Act
+  concore2full::when_all(std::span{futures}).await();
+
+  // Assert
+  int sum = 0;
+  for (auto& f : futures)
+    sum += f.await();
+  REQUIRE(sum == 45);
+}
+
+TEST_CASE("when_all works with copyable_spawn futures", "[when_all]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  auto f1 = concore2full::copyable_spawn([]() -> int { return 13; });
+  auto f2 = f1;
+  auto f3 = concore2full::escaping_spawn([]() -> int { return 17; });
+
+  // Act
+  concore2full::when_all(f1, f3).await();
+
+  // Assert
+  REQUIRE(f1.await() == 13);
+  REQUIRE(f2.await() == 13);
+  REQUIRE(f3.await() == 17);
+}
+
+TEST_CASE("when_all on an empty range completes immediately", "[when_all]") {
+  // Arrange
+  using future_t = decltype(concore2full::escaping_spawn(return_value_fun{0}));
+  std::vector<future_t> futures;
+
+  // Act
+  concore2full::when_all(std::span{futures}).await();
+}
+
+TEST_CASE("when_any returns the index of the first completed future", "[when_all]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  std::binary_semaphore can_finish{0};
+  auto f1 = concore2full::escaping_spawn([&]() -> int {
+    can_finish.acquire();
+    return 1;
+  });
+  auto f2 = concore2full::escaping_spawn([]() -> int { return 2; });
+
+  // Act
+  auto index = concore2full::when_any(f1, f2).await();
+  can_finish.release();
+
+  // Assert
+  REQUIRE(index == 1);
+  REQUIRE(f1.await() == 1);
+  REQUIRE(f2.await() == 2);
+}
+
+TEST_CASE("when_any over no futures yields an invalid index", "[when_all]") {
+  concore2full::profiling::zone zone{CURRENT_LOCATION()};
+  // Arrange
+  using future_t = decltype(concore2full::escaping_spawn(return_value_fun{0}));
+  std::vector<future_t> futures;
+
+  // Act
+  auto index = concore2full::when_any(std::span{futures}).await();
+
+  // Assert
+  REQUIRE(index == concore2full::when_any_no_index);
+}